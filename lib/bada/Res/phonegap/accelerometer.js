@@ -22,7 +22,11 @@ function Accelerometer() {
      * The last known acceleration.  type=Acceleration()
      */
     this.lastAcceleration = null;
-    this.id = null;
+
+    /**
+     * Active watches by id, each remembers whether it wants every sample.
+     */
+    this.watches = {};
 };
 
 /**
@@ -61,7 +65,7 @@ Accelerometer.prototype.getCurrentAcceleration = function(successCallback, error
 Accelerometer.prototype.watchAcceleration = function(successCallback, errorCallback, options) {
 
     // Default interval (10 sec)
-    var frequency = (options != undefined) ? options.frequency : 10000;
+    var frequency = (options != undefined && options.frequency) ? options.frequency : 10000;
 
     // successCallback required
     if (typeof successCallback != "function") {
@@ -74,10 +78,11 @@ Accelerometer.prototype.watchAcceleration = function(successCallback, errorCallb
         console.log("Accelerometer Error: errorCallback is not a function");
         return;
     }
-    // Start watch timer
-    this.id = PhoneGap.createUUID();
-    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Accelerometer", "watchAcceleration", []);
-    return this.id;
+    // Samples are buffered natively and delivered once per frequency period
+    var id = PhoneGap.createUUID();
+    this.watches[id] = {batch: (options != undefined) && !!options.batch};
+    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Accelerometer", "watchAcceleration", [id, {frequency: frequency}]);
+    return id;
 };
 
 /**
@@ -87,9 +92,30 @@ Accelerometer.prototype.watchAcceleration = function(successCallback, errorCallb
  */
 Accelerometer.prototype.clearWatch = function(id) {
 
-    // Stop javascript timer & remove from timer list
-    if (id == this.id) {
-        PhoneGap.exec(null, null, "com.phonegap.Accelerometer", "clearWatch", []);
+    if (this.watches[id]) {
+        delete this.watches[id];
+        PhoneGap.exec(null, null, "com.phonegap.Accelerometer", "clearWatch", [id]);
+    }
+};
+
+/*
+ * Native callback delivering the samples buffered since the last period, packed as
+ * [x, y, z, timestamp, x, y, z, timestamp, ...]. The watch gets the newest acceleration,
+ * or every sample when it was started with options.batch.
+ */
+Accelerometer.prototype._samples = function(id, callbackId, samples) {
+    var accels = [];
+    for (var i = 0; i + 3 < samples.length; i += 4) {
+        accels.push(new Acceleration(samples[i], samples[i + 1], samples[i + 2], samples[i + 3]));
+    }
+    if (accels.length == 0) {
+        return;
+    }
+    this.lastAcceleration = accels[accels.length - 1];
+    var watch = this.watches[id];
+    var callback = PhoneGap.callbacks[callbackId];
+    if (watch && callback && callback.success) {
+        callback.success(watch.batch ? accels : this.lastAcceleration);
     }
 };
 
@@ -50,6 +50,8 @@ Camera.prototype.PictureSourceType = Camera.PictureSourceType;
  * image as defined by the "options.destinationType" option.
 
  * The defaults are sourceType=CAMERA and destinationType=DATA_URL.
+ * successCallback receives the picture URI and the URI of a preview fitting in
+ * options.targetWidth x options.targetHeight (null if it could not be made).
  *
  * @param {Function} successCallback
  * @param {Function} errorCallback
@@ -82,7 +84,18 @@ Camera.prototype.getPicture = function(successCallback, errorCallback, options)
     if (typeof this.options.sourceType == "number") {
         sourceType = this.options.sourceType;
     }
-    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Camera", "getPicture", [quality, destinationType, sourceType]);
+    // Size of the preview made natively
+    var preview = {};
+    if (this.options.targetWidth) {
+        preview.targetWidth = this.options.targetWidth;
+    }
+    if (this.options.targetHeight) {
+        preview.targetHeight = this.options.targetHeight;
+    }
+    if (this.options.saveToPhotoAlbum) {
+        preview.saveToPhotoAlbum = true;
+    }
+    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Camera", "getPicture", [quality, destinationType, sourceType, preview]);
 };
 
 PhoneGap.addConstructor(function() {
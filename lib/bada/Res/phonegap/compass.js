@@ -4,9 +4,9 @@
  */
 function Compass() {
     /**
-     * The last known Compass position.
+     * Active watch ids.
      */
-  this.uuid = null;
+  this.watches = {};
 };
 
 /**
@@ -29,12 +29,18 @@ Compass.prototype.getCurrentHeading = function(successCallback, errorCallback, o
  * @param {Function} errorCallback The function to call when there is an error 
  * getting the heading data.
  * @param {HeadingOptions} options The options for getting the heading data
- * such as timeout and the frequency of the watch.
+ * such as timeout and the frequency of the watch. filter (degrees) reports the
+ * heading only when it changes by more than that, smoothing (0 to 1) sets the
+ * weight of a new sample in the native low-pass filter.
  */
 Compass.prototype.watchHeading= function(successCallback, errorCallback, options) {
-  this.uuid = PhoneGap.createUUID();
-  PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Compass", "watchHeading", [this.uuid, options.frequency || 3000]);
-  return this.uuid;
+  var uuid = PhoneGap.createUUID();
+  var settings = {};
+  if (options && options.filter) settings.filter = options.filter;
+  if (options && options.smoothing) settings.smoothing = options.smoothing;
+  this.watches[uuid] = true;
+  PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Compass", "watchHeading", [uuid, (options && options.frequency) || 3000, settings]);
+  return uuid;
 };
 
 
@@ -43,9 +49,9 @@ Compass.prototype.watchHeading= function(successCallback, errorCallback, options
  * @param {String} watchId The ID of the watch returned from #watchHeading.
  */
 Compass.prototype.clearWatch = function(watchId) {
-    if(this.uuid == watchId) {
-      PhoneGap.exec(null, null, "com.phonegap.Compass", "clearWatch", [this.uuid]);
-      this.uuid = null;
+    if(this.watches[watchId]) {
+      PhoneGap.exec(null, null, "com.phonegap.Compass", "clearWatch", [watchId]);
+      delete this.watches[watchId];
     } else {
       debugPrint('no clear watch');
     }
@@ -132,9 +132,9 @@ Contact.prototype.clone = function() {
 * @param errorCB error callback - optional
 */
 Contact.prototype.save = function(successCB, errorCB) {
-  // Read by Bada to create contact
+  // Sent along with the command, Bada saves contacts off the UI thread and cannot read the page
   var id = navigator.service.contacts.records.push(this) - 1;
-	PhoneGap.exec(successCB, errorCB, "com.phonegap.Contacts", "save", [id]);
+	PhoneGap.exec(successCB, errorCB, "com.phonegap.Contacts", "save", [navigator.service.contacts._serialize(id)]);
 };
 
 /**
@@ -242,24 +242,65 @@ Contacts.prototype.find = function(fields, successCB, errorCB, options) {
   /* fields searched are: displayName, Email, Phone Number, User Id
    * other fields are ignored
    */
-	PhoneGap.exec(successCB, errorCB, "com.phonegap.Contacts","find",[options.filter]);
+	PhoneGap.exec(successCB, errorCB, "com.phonegap.Contacts","find",[options.filter, options.pageSize ? {pageSize: options.pageSize} : null]);
 };
 
 /**
-* need to turn the JSON string representing contact object into actual object
-* @param JSON string with contact data
-* Call stored results function with  Contact object
+* Bada ONLY
+* Receives one page of search results from the native side.
+* @param contacts array of contact properties
 */
-Contacts.prototype._findCallback = function(contact)
+Contacts.prototype._findPage = function(contacts)
 {
-	if(contact) {
+	for(var i = 0 ; i < contacts.length ; i++) {
 		try {
-      this.results.push(this.create(contact));
+      this.results.push(this.create(contacts[i]));
 		} catch(e){
 			console.log("Error parsing contact");
 		}
 	}
 };
+/**
+* Bada ONLY
+* Serializes a pending record, it is sent as the argument of the save command.
+* The record is released once serialized.
+* @param id index in navigator.service.contacts.records
+* @return JSON string read by Contacts::Create
+*/
+Contacts.prototype._serialize = function(id) {
+  var contact = this.records[id];
+  this.records[id] = null;
+  if(!contact) {
+    return "";
+  }
+  var fields = function(list) {
+    var result = [];
+    if(list) {
+      for(var i = 0 ; i < list.length ; i++) {
+        if(list[i]) {
+          result.push({type: list[i].type, value: list[i].value});
+        }
+      }
+    }
+    return result;
+  };
+  var organization = contact.organization || (contact.organizations && contact.organizations[0]);
+  var address = contact.address || (contact.addresses && contact.addresses[0]);
+  var record = {
+    nickname: contact.nickname,
+    name: contact.name ? {givenName: contact.name.givenName, familyName: contact.name.familyName} : null,
+    phoneNumbers: fields(contact.phoneNumbers),
+    emails: fields(contact.emails),
+    urls: fields(contact.urls),
+    organization: organization ? {name: organization.name, title: organization.title} : null,
+    birthday: contact.birthday instanceof Date ? {year: contact.birthday.getFullYear(),
+                                                  month: contact.birthday.getMonth() + 1,
+                                                  day: contact.birthday.getDate()} : null,
+    address: address ? {streetAddress: address.streetAddress, locality: address.locality, region: address.region,
+                        postalCode: address.postalCode, country: address.country} : null
+  };
+  return JSON.stringify(record);
+};
 /** 
 * Need to return an error object rather than just a single error code
 * @param error code
@@ -305,11 +346,13 @@ Contacts.prototype.create = function(properties) {
  * @param filter used to match contacts against
  * @param multiple boolean used to determine if more than one contact should be returned
  * @param updatedSince return only contact records that have been updated on or after the given time
+ * @param pageSize Bada ONLY number of contacts delivered per script evaluation
  */
-var ContactFindOptions = function(filter, multiple, updatedSince) {
+var ContactFindOptions = function(filter, multiple, updatedSince, pageSize) {
     this.filter = filter || '';
     this.multiple = multiple || true;
     this.updatedSince = updatedSince || '';
+    this.pageSize = pageSize || null;
 };
 
 /**
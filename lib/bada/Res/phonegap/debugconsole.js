@@ -7,6 +7,49 @@ function DebugConsole(isDeprecated) {
     this.isDeprecated = isDeprecated ? true : false;
 }
 
+/**
+ * Lines waiting to be sent, [message, level, message, level...]. They go with the next
+ * batch of commands, or on their own after FLUSH_DELAY ms.
+ */
+DebugConsole.pending = [];
+DebugConsole.timer = null;
+DebugConsole.FLUSH_DELAY = 500;
+DebugConsole.MAX_PENDING = 64;
+// The native side reads at most 16 arguments per command
+DebugConsole.LINES_PER_COMMAND = 8;
+
+DebugConsole.flush = function() {
+    if (DebugConsole.timer != null) {
+        clearTimeout(DebugConsole.timer);
+        DebugConsole.timer = null;
+    }
+    var step = 2 * DebugConsole.LINES_PER_COMMAND;
+    for (var i = 0; i < DebugConsole.pending.length; i += step) {
+        PhoneGap.queue.commands.push([null, null, 'com.phonegap.DebugConsole', 'log', DebugConsole.pending.slice(i, i + step)]);
+    }
+    DebugConsole.pending = [];
+};
+
+DebugConsole.write = function(message, level) {
+    // Empty arguments are not sent, they would shift the pairs
+    if (message === undefined || message === null || message === '') {
+        return;
+    }
+    DebugConsole.pending.push(message, level);
+    if (DebugConsole.pending.length >= 2 * DebugConsole.MAX_PENDING) {
+        DebugConsole.flush();
+        PhoneGap.queue.schedule();
+    } else if (DebugConsole.timer == null) {
+        DebugConsole.timer = setTimeout(function() {
+            DebugConsole.timer = null;
+            DebugConsole.flush();
+            PhoneGap.queue.schedule();
+        }, DebugConsole.FLUSH_DELAY);
+    }
+};
+
+PhoneGap.queue.flushers.push(DebugConsole.flush);
+
 // from most verbose, to least verbose
 DebugConsole.ALL_LEVEL    = 1; // same as first level
 DebugConsole.INFO_LEVEL   = 1;
@@ -14,8 +57,22 @@ DebugConsole.WARN_LEVEL   = 2;
 DebugConsole.ERROR_LEVEL  = 4;
 DebugConsole.NONE_LEVEL   = 8;
 													
+DebugConsole.LEVEL_NAMES = {1: 'INFO', 2: 'WARN', 4: 'ERROR', 8: 'NONE'};
+
+/**
+ * Sets the minimum level of the lines kept, on the native side too.
+ */
 DebugConsole.prototype.setLevel = function(level) {
     this.logLevel = level;
+    PhoneGap.exec(null, null, 'com.phonegap.DebugConsole', 'setLevel', [DebugConsole.LEVEL_NAMES[level] || 'INFO']);
+}
+
+/**
+ * Passes the last lines kept by the native side (at most count) to successCallback.
+ */
+DebugConsole.prototype.dump = function(successCallback, count) {
+    DebugConsole.flush();
+    PhoneGap.exec(successCallback, null, 'com.phonegap.DebugConsole', 'dump', [count || 0]);
 }
 
 /**
@@ -66,9 +123,7 @@ DebugConsole.prototype.processMessage = function(message, maxDepth) {
  */
 DebugConsole.prototype.log = function(message, maxDepth) {
     if (PhoneGap.available && this.logLevel <= DebugConsole.INFO_LEVEL)
-        PhoneGap.exec(null, null, 'com.phonegap.DebugConsole', 'log',
-            [this.processMessage(message, maxDepth), 'INFO']
-        );
+        DebugConsole.write(this.processMessage(message, maxDepth), 'INFO');
     else
         console.log(message);
 };
@@ -79,9 +134,7 @@ DebugConsole.prototype.log = function(message, maxDepth) {
  */
 DebugConsole.prototype.warn = function(message, maxDepth) {
     if (PhoneGap.available && this.logLevel <= DebugConsole.WARN_LEVEL)
-        PhoneGap.exec(null, null, 'com.phonegap.DebugConsole', 'log',
-            [this.processMessage(message, maxDepth), 'WARN']
-        );
+        DebugConsole.write(this.processMessage(message, maxDepth), 'WARN');
     else
         console.error(message);
 };
@@ -92,9 +145,7 @@ DebugConsole.prototype.warn = function(message, maxDepth) {
  */
 DebugConsole.prototype.error = function(message, maxDepth) {
     if (PhoneGap.available && this.logLevel <= DebugConsole.ERROR_LEVEL)
-        PhoneGap.exec(null, null, 'com.phonegap.DebugConsole', 'log',
-            [this.processMessage(message, maxDepth), 'ERROR']
-        );
+        DebugConsole.write(this.processMessage(message, maxDepth), 'ERROR');
     else
         console.error(message);
 };
@@ -102,4 +153,12 @@ DebugConsole.prototype.error = function(message, maxDepth) {
 PhoneGap.addConstructor(function() {
     window.console = new DebugConsole();
     window.debug = new DebugConsole(true);
+    // The native side decides the minimum level, lines below it are not even sent
+    PhoneGap.exec(function(name) {
+        for (var level in DebugConsole.LEVEL_NAMES) {
+            if (DebugConsole.LEVEL_NAMES[level] == name) {
+                window.console.logLevel = window.debug.logLevel = Number(level);
+            }
+        }
+    }, null, 'com.phonegap.DebugConsole', 'getLevel', []);
 });
@@ -85,9 +85,10 @@ FileMgr.prototype.getFreeDiskSpace = function(filePath) {
  * @param encoding          The encoding to use to encode the file's content
  * @param successCallback   Callback invoked with file contents
  * @param errorCallback     Callback invoked on error
+ * @param progressCallback  Callback invoked with (loaded, total) after each chunk (OPTIONAL)
  */
-FileMgr.prototype.readAsText = function(fileName, encoding, successCallback, errorCallback) {
-    PhoneGap.exec(successCallback, errorCallback, "File", "readAsText", [fileName, encoding]);
+FileMgr.prototype.readAsText = function(fileName, encoding, successCallback, errorCallback, progressCallback) {
+    PhoneGap.exec(FileMgr.chunkReader(successCallback, progressCallback), errorCallback, "com.phonegap.File", "readAsText", [fileName, encoding]);
 };
 
 /**
@@ -96,22 +97,72 @@ FileMgr.prototype.readAsText = function(fileName, encoding, successCallback, err
  * @param fileName          The full path of the file to read.
  * @param successCallback   Callback invoked with file contents
  * @param errorCallback     Callback invoked on error
+ * @param progressCallback  Callback invoked with (loaded, total) after each chunk (OPTIONAL)
  */
-FileMgr.prototype.readAsDataURL = function(fileName, successCallback, errorCallback) {
-    PhoneGap.exec(successCallback, errorCallback, "File", "readAsDataURL", [fileName]);
+FileMgr.prototype.readAsDataURL = function(fileName, successCallback, errorCallback, progressCallback) {
+    PhoneGap.exec(FileMgr.chunkReader(successCallback, progressCallback), errorCallback, "com.phonegap.File", "readAsDataURL", [fileName]);
 };
 
+/**
+ * The native side sends a file in chunks of {data, loaded, total, done} through the
+ * success callback. Returns the callback collecting them and passing the whole content
+ * to successCallback once the last chunk arrived.
+ *
+ * @private
+ */
+FileMgr.chunkReader = function(successCallback, progressCallback) {
+    var parts = [];
+    return function(chunk) {
+        parts.push(chunk.data);
+        if (typeof progressCallback == "function") {
+            progressCallback(chunk.loaded, chunk.total);
+        }
+        if (chunk.done) {
+            var result = parts.join("");
+            parts = [];
+            successCallback(result);
+        }
+    };
+};
+
+/**
+ * Characters sent to the native side per write command.
+ */
+FileMgr.WRITE_CHUNK = 16384;
+
 /**
  * Writes data to the specified file.
  * 
  * @param fileName          The full path of the file to write
  * @param data              The data to be written
  * @param position          The position in the file to begin writing
- * @param successCallback   Callback invoked after successful write operation
+ * @param successCallback   Callback invoked with the number of bytes written
  * @param errorCallback     Callback invoked on error
+ * @param progressCallback  Callback invoked with (characters written, total characters) after each chunk (OPTIONAL)
  */
-FileMgr.prototype.write = function(fileName, data, position, successCallback, errorCallback) {
-    PhoneGap.exec(successCallback, errorCallback, "File", "write", [fileName, data, position]);
+FileMgr.prototype.write = function(fileName, data, position, successCallback, errorCallback, progressCallback) {
+    var offset = 0;
+    var written = 0;
+    var next = function() {
+        var end = Math.min(offset + FileMgr.WRITE_CHUNK, data.length);
+        // keep surrogate pairs in the same chunk
+        if (end < data.length && (data.charCodeAt(end - 1) & 0xFC00) == 0xD800) {
+            end--;
+        }
+        PhoneGap.exec(function(bytes) {
+            written += bytes;
+            offset = end;
+            if (typeof progressCallback == "function") {
+                progressCallback(offset, data.length);
+            }
+            if (offset < data.length) {
+                next();
+            } else if (typeof successCallback == "function") {
+                successCallback(written);
+            }
+        }, errorCallback, "com.phonegap.File", "write", [fileName, data.substring(offset, end), position + written]);
+    };
+    next();
 };
 
 /**
@@ -161,7 +212,7 @@ FileMgr.prototype.getFileProperties = function(fileName) {
  * @param errorCallback     Callback invoked on error
  */
 FileMgr.prototype.truncate = function(fileName, size, successCallback, errorCallback) {
-    PhoneGap.exec(successCallback, errorCallback, "File", "truncate", [fileName, size]);
+    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.File", "truncate", [fileName, size]);
 };
 
 /**
@@ -345,6 +396,14 @@ FileReader.prototype.readAsText = function(file, encoding) {
                 event = {"type":"loadend", "target":me};
                 me.onloadend(event);
             }
+        },
+
+        // progress callback
+        function(loaded, total) {
+            if (me.readyState !== FileReader.DONE && typeof me.onprogress == "function") {
+                event = {"type":"progress", "target":me, "loaded":loaded, "total":total};
+                me.onprogress(event);
+            }
         }
     );
 };
@@ -414,6 +473,14 @@ FileReader.prototype.readAsDataURL = function(file) {
                 event = {"type":"loadend", "target":me};
                 me.onloadend(event);
             }
+        },
+
+        // progress callback
+        function(loaded, total) {
+            if (me.readyState !== FileReader.DONE && typeof me.onprogress == "function") {
+                event = {"type":"progress", "target":me, "loaded":loaded, "total":total};
+                me.onprogress(event);
+            }
         }
     );
 };
@@ -665,6 +732,14 @@ FileWriter.prototype.write = function(data) {
                 event = {"type":"writeend", "target":me};
                 me.onwriteend(event);
             }
+        },
+
+        // progress callback
+        function(loaded, total) {
+            if (me.readyState !== FileWriter.DONE && typeof me.onprogress == "function") {
+                event = {"type":"progress", "target":me, "loaded":loaded, "total":total};
+                me.onprogress(event);
+            }
         }
     );
 };
@@ -15,7 +15,8 @@ function Geolocation() {
 
     // The last known GPS position.
     this.lastPosition = null;
-    this.id = null;
+    // Active watches, by id
+    this.watches = {};
 };
 
 /**
@@ -42,7 +43,6 @@ PositionError.TIMEOUT = 3;
  * @param {PositionOptions} options     The options for getting the position data. (OPTIONAL)
  */
 Geolocation.prototype.getCurrentPosition = function(successCallback, errorCallback, options) {
-    this.id = PhoneGap.createUUID();
     // default maximumAge value should be 0, and set if positive 
     var maximumAge = 0;
 
@@ -71,6 +71,7 @@ Geolocation.prototype.getCurrentPosition = function(successCallback, errorCallba
  * @param {Function} successCallback    The function to call each time the location data is available
  * @param {Function} errorCallback      The function to call when there is an error getting the location data. (OPTIONAL)
  * @param {PositionOptions} options     The options for getting the location data such as frequency. (OPTIONAL)
+ *                                      minimumInterval (ms) and distanceFilter (m) thin out the updates of this watch.
  * @return String                       The watch id that must be passed to #clearWatch to stop watching.
  */
 Geolocation.prototype.watchPosition = function(successCallback, errorCallback, options) {
@@ -78,10 +79,9 @@ Geolocation.prototype.watchPosition = function(successCallback, errorCallback, o
     // default maximumAge value should be 0, and set if positive 
     var maximumAge = 0;
 
-    // DO NOT set timeout to a large value for watchPosition in BlackBerry.  
-    // The interval used for updates is half the timeout value, so a large 
-    // timeout value will mean a long wait for the first location.
-    var timeout = 10000; 
+    // default timeout value is 0, no timeout. The update interval is kept
+    // within half the timeout, so only pass one when the page asks for it.
+    var timeout = 0;
 
     var enableHighAccuracy = false;
     if (options) {
@@ -95,9 +95,19 @@ Geolocation.prototype.watchPosition = function(successCallback, errorCallback, o
             timeout = (options.timeout < 0) ? 0 : options.timeout;
         }
     }
-    this.id = PhoneGap.createUUID();
-    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Geolocation", "watchPosition", [maximumAge, timeout, enableHighAccuracy]);
-    return this.id;
+    var id = PhoneGap.createUUID();
+    var watch = {id: id};
+    if (options) {
+        if (options.minimumInterval > 0) {
+            watch.minimumInterval = options.minimumInterval;
+        }
+        if (options.distanceFilter > 0) {
+            watch.distanceFilter = options.distanceFilter;
+        }
+    }
+    this.watches[id] = watch;
+    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Geolocation", "watchPosition", [maximumAge, timeout, enableHighAccuracy, watch]);
+    return id;
 };
 
 /**
@@ -106,8 +116,11 @@ Geolocation.prototype.watchPosition = function(successCallback, errorCallback, o
  * @param {String} id       The ID of the watch returned from #watchPosition
  */
 Geolocation.prototype.clearWatch = function(id) {
-    PhoneGap.exec(null, null, "com.phonegap.Geolocation", "stop", []);
-    this.id = null;
+    if (!this.watches[id]) {
+        return;
+    }
+    delete this.watches[id];
+    PhoneGap.exec(null, null, "com.phonegap.Geolocation", "stop", [id]);
 };
 
 /**
@@ -27,21 +27,40 @@ function Network() {
 		remoteHostStatus: int(0/1/2), internetConnectionStatus: int(0/1/2), localWiFiConnectionStatus: int (0/2) }
      */
 	this.lastReachability = null;
+    /**
+     * Current connection, kept up to date by the native side.
+     */
+    this.connection = { type: Connection.UNKNOWN };
+};
+
+/**
+ * Connection types reported in navigator.network.connection.type
+ */
+function Connection() {
 };
 
+Connection.UNKNOWN = "unknown";
+Connection.NONE = "none";
+Connection.WIFI = "wifi";
+Connection.CELL = "cellular";
+
 /**
  * Determine if a URI is reachable over the network.
 
  * @param {Object} uri
  * @param {Function} callback
- * @param {Object} options  (isIpAddress:boolean)
+ * @param {Object} options  (isIpAddress:boolean, maximumAge:ms an earlier answer for the same host may be reused)
  */
 Network.prototype.isReachable = function(uri, callback, options) {
     var isIpAddress = false;
     if (options && options.isIpAddress) {
         isIpAddress = options.isIpAddress;
     }
-    PhoneGap.exec(callback, null, 'com.phonegap.Network', 'isReachable', [uri, isIpAddress]);
+    var args = [uri, isIpAddress];
+    if (options && typeof options.maximumAge == "number") {
+        args.push({maximumAge: options.maximumAge});
+    }
+    PhoneGap.exec(callback, null, 'com.phonegap.Network', 'isReachable', args);
 };
 
 /**
@@ -53,6 +72,36 @@ Network.prototype.updateReachability = function(reachability) {
     this.lastReachability = reachability;
 };
 
+/**
+ * Called by the native side when the connection type changes. Fires "online" and "offline"
+ * on the document when the device gains or loses its connection, "connectionchange" on any change.
+ * @param {String} type The new connection type (Connection.*)
+ */
+Network.prototype.updateConnection = function(type) {
+    var previous = this.connection.type;
+    if (previous == type) {
+        return;
+    }
+    this.connection.type = type;
+    var fire = function(name) {
+        var e = document.createEvent('Events');
+        e.initEvent(name, false, false);
+        e.connectionType = type;
+        document.dispatchEvent(e);
+    };
+    // The first report only sets the initial type
+    if (previous == Connection.UNKNOWN) {
+        return;
+    }
+    if (type == Connection.NONE) {
+        fire('offline');
+    } else if (previous == Connection.NONE) {
+        fire('online');
+    }
+    fire('connectionchange');
+};
+
 PhoneGap.addConstructor(function() {
 	if (typeof navigator.network == "undefined") navigator.network = new Network();
+	PhoneGap.exec(null, null, 'com.phonegap.Network', 'watchConnection', []);
 });
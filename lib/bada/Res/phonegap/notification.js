@@ -85,11 +85,13 @@ Notification.prototype.confirm = function(message, resultCallback, title, button
 };
 
 /**
- * Causes the device to vibrate.
- * @param {Integer} mills The number of milliseconds to vibrate for.
+ * Causes the device to vibrate. Returns right away, vibrations and beeps are played in turn.
+ * @param {Integer|Integer[]} mills The number of milliseconds to vibrate for, or a
+ *                                  [vibrate, pause, vibrate, ...] pattern in milliseconds.
  */
 Notification.prototype.vibrate = function(mills) {
-    PhoneGap.exec(null, null, 'com.phonegap.Notification', 'vibrate', [mills]);
+    var duration = (mills instanceof Array) ? mills.join(",") : mills;
+    PhoneGap.exec(null, null, 'com.phonegap.Notification', 'vibrate', [duration]);
 };
 
 /**
@@ -100,6 +102,13 @@ Notification.prototype.beep = function(count) {
     PhoneGap.exec(null, null, 'com.phonegap.Notification', 'beep', [count]);
 };
 
+/**
+ * Stops the current vibration and drops the vibrations and beeps still pending.
+ */
+Notification.prototype.cancel = function() {
+    PhoneGap.exec(null, null, 'com.phonegap.Notification', 'cancel', []);
+};
+
 PhoneGap.addConstructor(function() {
     if (typeof navigator.notification == "undefined") navigator.notification = new Notification();
 });
@@ -43,7 +43,10 @@ PhoneGap = {
    queue: {
         ready: true,
         commands: [],
-        timer: null
+        timer: null,
+        maxLength: 8192,
+        // Called before each send, to queue commands that were held back (e.g. log lines)
+        flushers: []
     },
     _constructors: []
 };
@@ -235,6 +238,14 @@ PhoneGap.onResume = new PhoneGap.Channel('onResume');
  */
 PhoneGap.onPause = new PhoneGap.Channel('onPause');
 
+/**
+ * onLowMemory channel is fired when the device runs low on memory, after the
+ * native side released its caches. Listeners get {freed: bytes freed natively}
+ * and should drop what they can rebuild. Caches released on a worker thread
+ * (the contact index) fire it again with what they freed.
+ */
+PhoneGap.onLowMemory = new PhoneGap.Channel('onLowMemory');
+
 // _nativeReady is global variable that the native side can set
 // to signify that the native code is ready. It is a global since 
 // it may be called before any PhoneGap JS is ready.
@@ -290,6 +301,8 @@ document.addEventListener = function(evt, handler, capture) {
         }
     } else if (e == 'pause') {
         PhoneGap.onPause.subscribe(handler);
+    } else if (e == 'lowmemory') {
+        PhoneGap.onLowMemory.subscribe(handler);
     } else {
         PhoneGap.m_document_addEventListener.call(document, evt, handler, capture);
     }
@@ -456,19 +469,41 @@ PhoneGap.UUIDcreatePart = function(length) {
  * execute with any race conditions, and only run when PhoneGap is ready to
  * receive them.
  *
+ * Commands queued during the same turn of the event loop are sent to the
+ * native side together in a single gap:// navigation.
  */
 PhoneGap.exec = function() { 
-	
     PhoneGap.queue.commands.push(arguments);
-    if (PhoneGap.queue.timer == null)
-        PhoneGap.queue.timer = setInterval(PhoneGap.run_command, 10);
+    PhoneGap.queue.schedule();
+};
+
+/**
+ * Schedules a flush of the command queue on the next turn of the event loop.
+ * Nothing is scheduled while a batch is still being processed by the native
+ * side; PhoneGap.queue.ack() reschedules once it has been handled.
+ */
+PhoneGap.queue.schedule = function() {
+    if (PhoneGap.queue.timer == null && PhoneGap.queue.ready && PhoneGap.queue.commands.length > 0) {
+        PhoneGap.queue.timer = setTimeout(PhoneGap.run_command, 0);
+    }
 };
 
 /**
- * Internal function used to dispatch the request to PhoneGap.  It processes the
- * command queue and executes the next command on the list.  Simple parameters are passed
- * as arguments on the url.  JavaScript objects converted into a JSON string and passed as a
- * query string argument of the url.
+ * Called by native code once every command of the last batch was dispatched.
+ */
+PhoneGap.queue.ack = function() {
+    PhoneGap.queue.ready = true;
+    PhoneGap.queue.schedule();
+};
+
+// Commands issued before the native side was ready are sent as soon as it is
+PhoneGap.onNativeReady.subscribeOnce(function() {
+    PhoneGap.queue.schedule();
+});
+
+/**
+ * Builds the "service.action/callbackId/arg1/arg2?key=value" form of a
+ * single queued command.
  * Arguments may be in one of two formats:
  *   FORMAT ONE (preferable)
  * The native side will call PhoneGap.callbackSuccess or PhoneGap.callbackError,
@@ -486,64 +521,92 @@ PhoneGap.exec = function() {
  * object parameters are passed as an array object [object1, object2] each object will be passed as JSON strings 
  * @private
  */
+PhoneGap.build_command = function(args) {
+    var service;
+    var callbackId = null;
+    var start = 0;
+    if (args[0] == null || typeof args[0] === "function") {
+        var success = args[0];
+        var fail = args[1];
+        service = args[2] + "." + args[3];
+        args = args[4] || [];  //array of arguments to 
+        if (success || fail) {
+            callbackId = service + PhoneGap.callbackId++;
+            PhoneGap.callbacks[callbackId] = {success:success, fail:fail};
+        }
+    } else { 
+        service = args[0]; 
+        start = 1;
+    }
+
+    var uri = [];
+    var query = [];
+    for (var i = start; i < args.length; i++) {
+        var arg = args[i];
+        if (arg == undefined || arg == null)
+            continue;
+        if (typeof(arg) == 'object') {
+            for (var key in arg) {
+                if (typeof(arg[key]) != 'object') {
+                    query.push(encodeURIComponent(key) + '=' + encodeURIComponent(arg[key]));
+                }
+            }
+        }
+        else {
+            uri.push(encodeURIComponent(arg));
+        }
+    }
+    var next = callbackId != null  ?  ("/" + callbackId + "/") : "/";
+    var command = service + next + uri.join("/");
+
+    if (query.length > 0) {
+        command += "?" + query.join("&");
+    }
+    return command;
+};
+
+/**
+ * Internal function used to dispatch the request to PhoneGap.  It drains the
+ * command queue and sends every pending command in one navigation.  A single
+ * command is sent as gap://service.action/callbackId/args, several commands
+ * as gap://batch/<command>/<command>/... where each command is URI encoded.
+ * Simple parameters are passed as arguments on the url.  JavaScript objects
+ * are passed as a query string argument of the url.
+ *
+ * @private
+ */
 PhoneGap.run_command = function() {
-    if (!PhoneGap.available() || !PhoneGap.queue.ready)
+    PhoneGap.queue.timer = null;
+    if (!PhoneGap.available() || !PhoneGap.queue.ready || PhoneGap.queue.commands.length == 0)
         return;
 
-    var args = PhoneGap.queue.commands.shift();
-    if (PhoneGap.queue.commands.length == 0) {
-        clearInterval(PhoneGap.queue.timer);
-        PhoneGap.queue.timer = null;
+    for (var f = 0; f < PhoneGap.queue.flushers.length; f++) {
+        PhoneGap.queue.flushers[f]();
     }
-	
-	var service;
-	var callbackId = null;
-	var start=0;
+
+    var commands = [];
+    var length = 0;
     try {
- 		if (args[0] == null || typeof args[0] === "function") {
- 			var success = args[0];
- 			var fail = args[1];
- 			service = args[2] + "." + args[3];
-			args = args[4];  //array of arguments to 
-      if (success || fail) {
-          callbackId = service + PhoneGap.callbackId++;
-          PhoneGap.callbacks[callbackId] = {success:success, fail:fail};
-      }
- 		} else { 
- 			service = args[0]; 
- 			start = 1;
- 		}
-        
-      var uri = [];
-      var query = [];
-    	for (var i = start; i < args.length; i++) {
-        	var arg = args[i];
-        	if (arg == undefined || arg == null)
-            	continue;
-        	if (typeof(arg) == 'object') {
-              for(i in arg) {
-                if(typeof(arg[i]) != 'object') {
-                  query.push(encodeURIComponent(i) + '=' + encodeURIComponent(arg[i]));
-                }
-              }
-          }
-        	else {
-            	uri.push(encodeURIComponent(arg));
-          }
-    	}
-    	var next = callbackId != null  ?  ("/" + callbackId + "/") : "/";
-    	var url = "gap://" + service + next + uri.join("/");
-
-    	if (query.length > 0) {
-        	url += "?" + query.join("&");
-    	}
-      PhoneGap.queue.ready = false;
-      document.location = url;
-   
+        while (PhoneGap.queue.commands.length > 0 &&
+               (commands.length == 0 || length < PhoneGap.queue.maxLength)) {
+            var command = PhoneGap.build_command(PhoneGap.queue.commands.shift());
+            length += command.length;
+            commands.push(command);
+        }
+
+        var url;
+        if (commands.length == 1) {
+            url = "gap://" + commands[0];
+        } else {
+            for (var i = 0; i < commands.length; i++) {
+                commands[i] = encodeURIComponent(commands[i]);
+            }
+            url = "gap://batch/" + commands.join("/");
+        }
+        PhoneGap.queue.ready = false;
+        document.location = url;
     } catch (e) {
+        PhoneGap.queue.ready = true;
         console.log("PhoneGapExec Error: "+e);
     }
-    
-
 };
-
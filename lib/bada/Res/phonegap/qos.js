@@ -0,0 +1,77 @@
+/*
+ * PhoneGap is available under *either* the terms of the modified BSD license *or* the
+ * MIT License (2008). See http://opensource.org/licenses/alphabetical for full text.
+ */
+
+/**
+ * Quality of service the native side follows, in tiers chosen from the battery level:
+ *   normal    whatever the page asks for
+ *   saving    battery low: slower sensors and location updates, smaller camera previews
+ *   critical  battery critical: slower still
+ * The page can override the tier, e.g. to keep full rates while plugged in a dock.
+ * @constructor
+ */
+function Qos() {
+    /**
+     * Policy in effect: {tier, batteryTier, overridden, sensorInterval (ms),
+     * locationInterval (s), previewSize (pixels), flushInterval (ms)}, null until known.
+     */
+    this.policy = null;
+
+    /**
+     * Called with the policy whenever its tier changes.
+     */
+    this.onchange = null;
+};
+
+Qos.TIER_NORMAL = "normal";
+Qos.TIER_SAVING = "saving";
+Qos.TIER_CRITICAL = "critical";
+
+/**
+ * Passes the policy in effect to successCallback.
+ *
+ * @param {Function} successCallback
+ */
+Qos.prototype.getPolicy = function(successCallback) {
+    PhoneGap.exec(successCallback, null, "com.phonegap.Qos", "getPolicy", []);
+};
+
+/**
+ * Overrides the tier chosen from the battery level until clearTier is called.
+ *
+ * @param {String} tier                 Qos.TIER_NORMAL, Qos.TIER_SAVING or Qos.TIER_CRITICAL
+ * @param {Function} successCallback    (OPTIONAL) gets the new policy
+ * @param {Function} errorCallback      (OPTIONAL)
+ */
+Qos.prototype.setTier = function(tier, successCallback, errorCallback) {
+    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Qos", "setTier", [tier]);
+};
+
+/**
+ * Follows the battery level again.
+ *
+ * @param {Function} successCallback    (OPTIONAL) gets the new policy
+ */
+Qos.prototype.clearTier = function(successCallback) {
+    PhoneGap.exec(successCallback, null, "com.phonegap.Qos", "clearTier", []);
+};
+
+/**
+ * Called by the native side when the tier changes.
+ */
+Qos.prototype._update = function(policy) {
+    this.policy = policy;
+    if (typeof this.onchange == "function") {
+        this.onchange(policy);
+    }
+};
+
+PhoneGap.addConstructor(function() {
+    if (typeof navigator.qos == "undefined") {
+        navigator.qos = new Qos();
+        navigator.qos.getPolicy(function(policy) {
+            navigator.qos.policy = policy;
+        });
+    }
+});
@@ -0,0 +1,47 @@
+/*
+ * PhoneGap is available under *either* the terms of the modified BSD license *or* the
+ * MIT License (2008). See http://opensource.org/licenses/alphabetical for full text.
+ */
+
+/**
+ * Latencies of the PhoneGap bridge, measured on the native side for every command.
+ * Each command is timed in stages (milliseconds):
+ *   queue     from the request until the native side dispatched it
+ *   handler   time spent in the native handler
+ *   callback  from the handler until its first callback was evaluated
+ *   total     from the request until its first callback was evaluated
+ * @constructor
+ */
+function Trace() {
+};
+
+/**
+ * Passes an array of {name, queue, handler, callback, total} to successCallback, one per
+ * service and one per service.method. Each stage is {count, p50, p95, p99, max}.
+ *
+ * @param {Function} successCallback
+ */
+Trace.prototype.getStats = function(successCallback) {
+    PhoneGap.exec(successCallback, null, "com.phonegap.Trace", "getStats", []);
+};
+
+/**
+ * Writes the same figures to a file on the device, its path is passed to successCallback.
+ *
+ * @param {Function} successCallback    (OPTIONAL)
+ * @param {Function} errorCallback      (OPTIONAL)
+ */
+Trace.prototype.dump = function(successCallback, errorCallback) {
+    PhoneGap.exec(successCallback, errorCallback, "com.phonegap.Trace", "dump", []);
+};
+
+/**
+ * Starts measuring again from scratch.
+ */
+Trace.prototype.reset = function() {
+    PhoneGap.exec(null, null, "com.phonegap.Trace", "reset", []);
+};
+
+PhoneGap.addConstructor(function() {
+    if (typeof navigator.trace == "undefined") navigator.trace = new Trace();
+});
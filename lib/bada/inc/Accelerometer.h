@@ -9,29 +9,81 @@
 #define ACCELEROMETER_H_
 
 #include "PhoneGapCommand.h"
+#include "SensorHub.h"
+#include "QosPolicy.h"
 #include <FUix.h>
 
 using namespace Osp::Uix;
+using namespace Osp::Base::Collection;
 
+struct AccelerationSample {
+	float x, y, z;
+	long long timestamp;
+};
+
+class Accelerometer;
+
+/*
+ * One watchAcceleration of the page, with its own delivery period and position
+ * in the ring buffer.
+ */
+class AccelerationWatch: public ITimerEventListener {
+public:
+	AccelerationWatch(Accelerometer& accelerometer, const String& watchId, const String& callbackId, int frequency);
+	virtual ~AccelerationWatch();
+	result Start(void);
+	void Stop(void);
+	void OnTimerExpired(Timer& timer);
+public:
+	String watchId;
+	String callbackId;
+	int frequency;
+	long long sent;
+private:
+	Accelerometer& __accelerometer;
+	Timer __timer;
+};
+
+/*
+ * Samples are written into a fixed ring buffer as they arrive and sent to each watch
+ * as one packed [x,y,z,timestamp,...] array per frequency period.
+ */
 class Accelerometer: public PhoneGapCommand, ISensorEventListener
  {
+public:
+	static const int RING_SIZE = 64;
+	static const int SAMPLE_INTERVAL = 50;
+	static const int DEFAULT_FREQUENCY = 10000;
 public:
 	Accelerometer();
 	Accelerometer(Web* pWeb);
 	virtual ~Accelerometer();
 public:
-	virtual void Run(const String& command);
+	virtual void Run(const CommandArgs& args);
+	virtual void Suspend(void);
+	virtual void Resume(void);
+	virtual void ApplyQos(void);
 	bool StartSensor(void);
 	bool StopSensor(void);
 	bool IsStarted(void);
-	void GetLastAcceleration(void);
+	void GetLastAcceleration(const String& callbackId);
+	void SendSamples(AccelerationWatch& watch);
 	void OnDataReceived(SensorType sensorType, SensorData& sensorData, result r);
 private:
-	SensorManager __sensorMgr;
-	bool started;
-	String callbackId;
-	float x, y, z;
-	long timestamp;
+	void Watch(const String& watchId, const String& callbackId, int frequency);
+	void ClearWatch(const String& watchId);
+	void Fail(const String& callbackId);
+	static long GetSampleInterval(void);
+private:
+	SensorHub* __pSensors;
+	// Ring buffer, __written counts every sample ever stored
+	AccelerationSample __samples[RING_SIZE];
+	long long __written;
+	HashMapT<String, AccelerationWatch*> __watches;
+	// getCurrentAcceleration calls waiting for the first sample
+	ArrayListT<String> __currentCallbacks;
+	// Watches and requests are kept while suspended, the sensor starts again on Resume()
+	bool __suspended;
 };
 
 #endif /* ACCELEROMETER_H_ */
@@ -0,0 +1,53 @@
+/*
+ * CommandRegistry.h
+ *
+ *  Maps a service name (e.g. com.phonegap.Accelerometer) to the PhoneGapCommand
+ *  handling it. Handlers register a factory and are only created on their first command.
+ */
+
+#ifndef COMMANDREGISTRY_H_
+#define COMMANDREGISTRY_H_
+
+#include <FBase.h>
+#include "PhoneGapCommand.h"
+
+using namespace Osp::Base::Collection;
+
+typedef PhoneGapCommand* (*PhoneGapCommandFactory)(Web* pWeb);
+
+class CommandRegistry {
+public:
+	CommandRegistry(Web* pWeb, ResultQueue* pResults, Worker* pWorker);
+	virtual ~CommandRegistry();
+	result Construct(void);
+public:
+	PhoneGapCommand* GetCommand(const String& service);
+	// Suspends or resumes every handler created so far
+	void Suspend(void);
+	void Resume(void);
+	// Handlers stop posting to the worker, e.g. before it is deleted
+	void DetachWorker(void);
+	// Bytes freed by the handlers on the UI thread
+	long ReleaseMemory(void);
+	void ApplyQos(void);
+	static bool Register(const mchar* service, PhoneGapCommandFactory factory);
+private:
+	Web* pWeb;
+	ResultQueue* pResults;
+	Worker* pWorker;
+	// Lane given to the next handler, handlers are spread over the worker threads
+	int __nextLane;
+	HashMapT<String, PhoneGapCommandFactory> __factories;
+	HashMapT<String, PhoneGapCommand*> __commands;
+};
+
+/*
+ * Registers a PhoneGapCommand subclass for the given service name.
+ * Use once in the subclass translation unit, e.g.
+ * REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Compass", Compass)
+ */
+#define REGISTER_PHONEGAP_COMMAND(service, className) \
+	static PhoneGapCommand* Create##className(Web* pWeb) { return new className(pWeb); } \
+	static bool className##Registered = CommandRegistry::Register(service, Create##className);
+
+#endif /* COMMANDREGISTRY_H_ */
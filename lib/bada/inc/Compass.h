@@ -10,26 +10,72 @@
 
 #include <FUix.h>
 #include "PhoneGapCommand.h"
+#include "SensorHub.h"
+#include "QosPolicy.h"
 
 using namespace Osp::Uix;
+using namespace Osp::Base::Collection;
+
+class Compass;
+
+/*
+ * One watchHeading of the page, listening to the sensor hub at its own frequency.
+ * Samples go through a low-pass filter, off by default; with a filter (deadband, in
+ * degrees) the heading is smoothed and only reported once it moved by more than that.
+ */
+class CompassWatch: public ISensorEventListener {
+public:
+	CompassWatch(Compass& compass, const String& callbackId, long frequency, float filter, float smoothing);
+	virtual ~CompassWatch();
+	bool Update(float sampleX, float sampleY, float sampleZ);
+	void OnDataReceived(SensorType sensorType, SensorData& sensorData, result r);
+public:
+	String callbackId;
+	long frequency;
+	float filter;
+	float smoothing;
+	// Filtered field and the heading it gives
+	float x, y, z;
+	float heading;
+private:
+	bool __primed;
+	bool __reported;
+	float __reportedHeading;
+	Compass& __compass;
+};
 
 class Compass: public PhoneGapCommand, ISensorEventListener {
+public:
+	static const int SAMPLE_INTERVAL = 50;
+	static const int DEFAULT_FREQUENCY = 3000;
 public:
 	Compass(Web* pWeb);
 	virtual ~Compass();
 public:
-	void Run(const String& command);
-	bool StartSensor(void);
-	bool StopSensor(void);
-	bool IsStarted(void);
-	void GetLastHeading(void);
+	virtual void Run(const CommandArgs& args);
+	virtual void Suspend(void);
+	virtual void Resume(void);
+	virtual void ApplyQos(void);
+	static float GetHeading(float x, float y);
+	void GetLastHeading(const String& callbackId);
 	void OnDataReceived(SensorType sensorType, SensorData& sensorData, result r);
+	void OnWatchData(CompassWatch& watch, SensorData& sensorData);
 private:
-	SensorManager __sensorMgr;
-	bool started;
-	String callbackId;
+	void Watch(const String& watchId, const String& callbackId, long frequency, float filter, float smoothing);
+	void SendHeading(const String& callbackId, float heading, float x, float y, float z);
+	void ClearWatch(const String& watchId);
+	void ReadSample(SensorData& sensorData);
+	void Fail(const String& callbackId);
+private:
+	SensorHub* __pSensors;
+	HashMapT<String, CompassWatch*> __watches;
+	// getCurrentHeading calls waiting for the first sample
+	ArrayListT<String> __currentCallbacks;
 	float x, y, z;
 	long timestamp;
+	bool hasSample;
+	// Watches and requests are kept while suspended, they listen again on Resume()
+	bool __suspended;
 };
 
 #endif /* COMPASS_H_ */
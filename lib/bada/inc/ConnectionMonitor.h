@@ -0,0 +1,64 @@
+/*
+ * ConnectionMonitor.h
+ *
+ *  Keeps the current connection type from the Wi-Fi and telephony network events,
+ *  so it can be read without querying the system and changes are reported as they happen.
+ */
+
+#ifndef CONNECTIONMONITOR_H_
+#define CONNECTIONMONITOR_H_
+
+#include <FBase.h>
+#include <FNet.h>
+#include <FTelephony.h>
+
+using namespace Osp::Base;
+using namespace Osp::Base::Collection;
+using namespace Osp::Net;
+using namespace Osp::Telephony;
+
+// Same values as the reachability codes sent to the page
+enum ConnectionType {
+	CONNECTION_NONE = 0,
+	CONNECTION_CELLULAR = 1,
+	CONNECTION_WIFI = 2
+};
+
+class IConnectionListener {
+public:
+	virtual ~IConnectionListener() {}
+	virtual void OnConnectionChanged(ConnectionType type) = 0;
+};
+
+/*
+ * The listener is only called when the type actually changes, not for every
+ * event (e.g. signal strength or roaming updates).
+ */
+class ConnectionMonitor: public Wifi::IWifiManagerEventListener, public ITelephonyNetworkEventListener {
+public:
+	ConnectionMonitor();
+	virtual ~ConnectionMonitor();
+	result Construct(IConnectionListener& listener);
+public:
+	ConnectionType GetType(void) const;
+	static const mchar* GetTypeName(ConnectionType type);
+public:
+	void OnWifiActivated(result r);
+	void OnWifiDeactivated(result r);
+	void OnWifiConnected(const String& ssid, result r);
+	void OnWifiDisconnected(void);
+	void OnWifiRssiChanged(long rssi);
+	void OnWifiScanCompletedN(const IList* pWifiBssInfoList, result r);
+	void OnTelephonyNetworkStatusChanged(const NetworkStatus& networkStatus);
+private:
+	void Update(void);
+private:
+	IConnectionListener* __pListener;
+	Wifi::WifiManager __wifiManager;
+	NetworkManager __networkManager;
+	bool __wifiConnected;
+	bool __dataAvailable;
+	ConnectionType __type;
+};
+
+#endif /* CONNECTIONMONITOR_H_ */
@@ -0,0 +1,70 @@
+/*
+ * ContactIndex.h
+ *
+ *  In-memory search index over the address book: names and emails (lower case)
+ *  and phone numbers (digits only). Built on the first search, then kept up to date
+ *  from the address book change events.
+ */
+
+#ifndef CONTACTINDEX_H_
+#define CONTACTINDEX_H_
+
+#include <FBase.h>
+#include <FSocial.h>
+
+using namespace Osp::Base;
+using namespace Osp::Base::Collection;
+using namespace Osp::Social;
+
+/*
+ * Snapshot of the searchable and reported fields of a contact.
+ */
+class ContactEntry: public Object {
+public:
+	ContactEntry(const Contact& contact);
+	virtual ~ContactEntry();
+	long GetMemorySize(void) const;
+public:
+	RecordId id;
+	String displayName;
+	String firstName;
+	String lastName;
+	IList* pPhoneNumbers;
+	IList* pEmails;
+	IList* pUrls;
+	// Lower case names and emails, digits of phone numbers, one per line
+	String text;
+	String digits;
+};
+
+class ContactIndex: public IAddressbookChangeEventListener {
+public:
+	ContactIndex();
+	virtual ~ContactIndex();
+	result Construct(void);
+public:
+	Addressbook* GetAddressbook(void);
+	ContactEntry* GetEntry(RecordId id) const;
+	result Search(const String& filter, ArrayListT<ContactEntry*>& hits);
+	void Invalidate(void);
+	// Bytes held by the entries and postings, estimated
+	long GetMemorySize(void) const;
+	void OnContactsChanged(const IList& contactChangeInfoList);
+	void OnCategoriesChanged(const IList& categoryChangeInfoList);
+private:
+	result Build(void);
+	void Clear(void);
+	void Add(ContactEntry* pEntry);
+	void Remove(RecordId id);
+	void UpdateKeys(RecordId id, const String& terms, bool add);
+	void UpdateKey(const String& key, RecordId id, bool add);
+	void Probe(const String& query, bool digits, ArrayListT<ContactEntry*>& hits);
+private:
+	Addressbook* __pAddressbook;
+	HashMapT<RecordId, ContactEntry*> __entries;
+	// trigram or ^prefix -> ids of the contacts containing it
+	HashMapT<String, ArrayListT<RecordId>*> __postings;
+	bool __built;
+};
+
+#endif /* CONTACTINDEX_H_ */
@@ -10,35 +10,75 @@
 
 #include <FSocial.h>
 #include "PhoneGapCommand.h"
+#include "JsonReader.h"
+#include "ContactIndex.h"
 using namespace Osp::Social;
 using namespace Osp::Base::Collection;
 
-class Contacts: public PhoneGapCommand {
+class Contacts;
+
+/*
+ * Drops the search index on the Contacts lane, it is rebuilt by the next search.
+ */
+class IndexReleaseTask: public WorkerTask {
+public:
+	IndexReleaseTask(Contacts& contacts);
+	virtual ~IndexReleaseTask();
+	void Execute(void);
+	void Complete(void);
+private:
+	Contacts& __contacts;
+	long __freed;
+};
+
+/*
+ * Runs on a worker lane: address book queries and writes do not hold the UI thread.
+ */
+class Contacts: public PhoneGapCommand, ITimerEventListener {
+public:
+	// Contacts sent per evaluation when the page does not give a pageSize
+	static const int DEFAULT_PAGE_SIZE = 50;
+	static const int PAGE_INTERVAL = 10;
 public:
 	Contacts(Web* pWeb);
 	virtual ~Contacts();
 public:
-	void Run(const String& command);
-	void Create(const int contactId);
-	void Find(const String& filter);
+	virtual CommandMode GetMode(void) const;
+	virtual void Run(const CommandArgs& args);
+	virtual long ReleaseMemory(void);
+	// Worker thread, returns the bytes freed
+	long ReleaseIndex(void);
+	// UI thread, tells the page what the index release freed
+	void ReportReleased(long freed);
+	void Create(const String& json);
+	void Find(const String& filter, int pageSize);
+	void OnTimerExpired(Timer& timer);
 	void Remove(const String& id);
 private:
 	String callbackId;
+	ContactIndex* __pIndex;
+	// Search results waiting to be sent
+	ArrayListT<RecordId> __pending;
+	// Constructed on the worker thread, where it fires
+	Timer __pageTimer;
+	bool __pageTimerConstructed;
+	String __findCallbackId;
+	int __pageSize;
+	int __next;
+	int __found;
 private:
-	void SetNickname(Contact& contact, const int cid);
-	void SetFirstName(Contact& contact, const int cid);
-	void SetLastName(Contact& contact, const int cid);
-	void SetPhoneNumbers(Contact& contact, const int cid);
-	void SetEmails(Contact& contact, const int cid);
-	void SetUrls(Contact& contact, const int cid);
-	void SetOrganization(Contact& contact, const int cid);
-	void SetBirthday(Contact& contact, const int cid);
-	void SetAddress(Contact& contact, const int cid);
-
-	void FindByName(const String& filter);
-	void FindByEmail(const String& filter);
-	void FindByPhoneNumber(const String& filter);
-	void UpdateSearch(Contact* contact) const;
+	result SetContact(Contact& contact, const String& json);
+	void SetName(Contact& contact, JsonReader& reader);
+	void SetPhoneNumbers(Contact& contact, JsonReader& reader);
+	void SetEmails(Contact& contact, JsonReader& reader);
+	void SetUrls(Contact& contact, JsonReader& reader);
+	void SetOrganization(Contact& contact, JsonReader& reader);
+	void SetBirthday(Contact& contact, JsonReader& reader);
+	void SetAddress(Contact& contact, JsonReader& reader);
+
+	ContactIndex* GetIndex(void);
+	void AppendContact(ScriptBuilder& script, const ContactEntry& entry) const;
+	void SendPage(void);
 
 };
 
@@ -9,16 +9,65 @@
 #define DEBUGCONSOLE_H_
 
 #include "PhoneGapCommand.h"
+#include <FIo.h>
 
-class DebugConsole: public PhoneGapCommand {
+using namespace Osp::Base::Runtime;
+using namespace Osp::Io;
+
+enum LogLevel {
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARN,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_NONE
+};
+
+/*
+ * Appends lines to the log file on the worker thread, the file is rotated once it gets too big.
+ */
+class LogFlushTask: public WorkerTask {
+public:
+	LogFlushTask(const String& lines);
+	virtual ~LogFlushTask();
+	void Execute(void);
+	void Complete(void);
+private:
+	String __lines;
+};
+
+/*
+ * Lines below the minimum level are dropped on arrival. The others go to a ring buffer
+ * holding the last RING_SIZE lines, which is written to the log file in batches.
+ */
+class DebugConsole: public PhoneGapCommand, ITimerEventListener {
+public:
+	static const int RING_SIZE = 256;
+	// Lines waiting before a flush is posted right away, otherwise flushed every FLUSH_INTERVAL ms
+	static const int FLUSH_LINES = 64;
+	static const int FLUSH_INTERVAL = 2000;
+	static const int MAX_LOG_SIZE = 65536;
 public:
 	DebugConsole(Web* pWeb);
 	virtual ~DebugConsole();
 public:
-	void Run(const String& command);
+	virtual void Run(const CommandArgs& args);
+	virtual void Suspend(void);
+	void OnTimerExpired(Timer& timer);
+private:
+	void Log(const String& statement, const String& logLevel);
+	void Flush(void);
+	void Dump(const String& callbackId, int count);
+	static LogLevel GetLevel(const String& name);
+	static const mchar* GetLevelName(LogLevel level);
 private:
-	void CleanUp(String& str);
-	void Log(String& statement, String& logLevel);
+	LogLevel __minLevel;
+	String __ring[RING_SIZE];
+	// Next slot written, lines held and lines not written to the file yet
+	int __head;
+	int __count;
+	int __unflushed;
+	Timer __flushTimer;
+	bool __flushScheduled;
 };
 
 #endif /* DEBUGCONSOLE_H_ */
@@ -13,14 +13,22 @@
 
 using namespace Osp::System;
 
+/*
+ * The device record does not change while the application runs: it is read from
+ * SystemInfo once and the script defining window.device is kept for every new document.
+ */
 class Device: public PhoneGapCommand {
 public:
 	Device();
 	Device(Web* pWeb);
 	virtual ~Device();
 public:
-	result SetDeviceInfo();
-	virtual void Run(const String& command);
+	const String& GetDeviceScript(void);
+	virtual void Run(const CommandArgs& args);
+private:
+	result BuildDeviceScript(void);
+private:
+	String __deviceScript;
 };
 
 #endif /* DEVICE_H_ */
@@ -0,0 +1,90 @@
+/*
+ * FileMgr.h
+ *
+ *  Reads and writes files for the page in bounded chunks: reads are sent one chunk
+ *  per timer tick through the success callback, data URLs are base64 encoded chunk
+ *  by chunk, writes are converted to UTF-8 a slice at a time.
+ */
+
+#ifndef FILEMGR_H_
+#define FILEMGR_H_
+
+#include "PhoneGapCommand.h"
+#include <FIo.h>
+#include <FText.h>
+
+using namespace Osp::Base::Collection;
+using namespace Osp::Base::Runtime;
+using namespace Osp::Io;
+using namespace Osp::Text;
+
+// Codes of FileError in file.js
+enum FileErrorCode {
+	FILE_ERROR_NOT_FOUND = 1,
+	FILE_ERROR_SECURITY = 2,
+	FILE_ERROR_ABORT = 3,
+	FILE_ERROR_NOT_READABLE = 4,
+	FILE_ERROR_ENCODING = 5,
+	FILE_ERROR_NO_MODIFICATION_ALLOWED = 6,
+	FILE_ERROR_INVALID_STATE = 7
+};
+
+/*
+ * A readAsText or readAsDataURL in progress. Text is decoded with pEncoding, a UTF-8
+ * sequence cut by the end of a chunk is carried over to the next one.
+ */
+class FileRead {
+public:
+	FileRead();
+	virtual ~FileRead();
+public:
+	String callbackId;
+	String path;
+	File file;
+	// null for data URLs
+	Encoding* pEncoding;
+	bool utf8;
+	long long total;
+	long long loaded;
+	// Start of a UTF-8 sequence left at the end of the previous chunk
+	byte carried[4];
+	int carry;
+};
+
+class FileMgr: public PhoneGapCommand, ITimerEventListener {
+public:
+	// Multiple of 3 so the base64 of consecutive chunks can be concatenated
+	static const int CHUNK_SIZE = 24576;
+	// Characters converted to UTF-8 at a time when writing
+	static const int WRITE_SLICE = 4096;
+	static const int CHUNK_INTERVAL = 10;
+public:
+	FileMgr(Web* pWeb);
+	virtual ~FileMgr();
+public:
+	virtual void Run(const CommandArgs& args);
+	virtual void Suspend(void);
+	virtual void Resume(void);
+	void OnTimerExpired(Timer& timer);
+private:
+	void Read(const String& callbackId, const String& fileName, const String& encoding, bool dataUrl);
+	void Write(const String& callbackId, const String& fileName, const String& data, long long position);
+	void Truncate(const String& callbackId, const String& fileName, long long size);
+	bool SendChunk(FileRead& read);
+	void Succeed(const String& callbackId, long long value);
+	void Fail(const String& callbackId, int code);
+	static int GetErrorCode(result r, int defaultCode);
+	static String GetPath(const String& fileName);
+	static const mchar* GetMimeType(const String& path);
+private:
+	ArrayListT<FileRead*> __reads;
+	Timer __chunkTimer;
+	// Reads are kept while suspended, no chunk is read until Resume()
+	bool __suspended;
+	// Shared by the reads, a chunk is encoded and sent before the next one is read
+	byte __buffer[CHUNK_SIZE + 4];
+	ByteBuffer __bytes;
+	Utf8Encoding __utf8;
+};
+
+#endif /* FILEMGR_H_ */
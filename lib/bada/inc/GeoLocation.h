@@ -9,27 +9,125 @@
 #define GEOLOCATION_H_
 
 #include "PhoneGapCommand.h"
+#include "QosPolicy.h"
 #include <FLocations.h>
 
 using namespace Osp::Locations;
+using namespace Osp::Base::Collection;
+using namespace Osp::Base::Runtime;
 
-class GeoLocation: public PhoneGapCommand, ILocationListener {
+// Codes of PositionError in geolocation.js
+enum PositionErrorCode {
+	POSITION_ERROR_UNKNOWN = 0,
+	POSITION_ERROR_PERMISSION_DENIED = 1,
+	POSITION_ERROR_UNAVAILABLE = 2,
+	POSITION_ERROR_TIMEOUT = 3
+};
+
+/*
+ * Last fix received, kept to answer getCurrentPosition within its maximumAge.
+ */
+struct PositionFix {
+	double latitude;
+	double longitude;
+	float altitude;
+	float accuracy;
+	float altitudeAccuracy;
+	float course;
+	float speed;
+	long long timestamp;
+	// Ticks when it was received
+	long long receivedAt;
+	bool valid;
+};
+
+/*
+ * getCurrentPosition waiting for a fix until its deadline.
+ */
+class PositionRequest: public Object {
+public:
+	PositionRequest(const String& callbackId, long long deadline, bool highAccuracy);
+	virtual ~PositionRequest();
+public:
+	String callbackId;
+	long long deadline;
+	bool highAccuracy;
+};
+
+/*
+ * watchPosition of the page. A fix reaches it only when minimumInterval (ms) elapsed
+ * and it moved by distanceFilter (m) since the last position it was sent.
+ */
+class PositionWatch: public Object {
+public:
+	PositionWatch(const String& callbackId, int timeout, bool highAccuracy, int minimumInterval, float distanceFilter);
+	virtual ~PositionWatch();
+	bool Accepts(const PositionFix& fix) const;
+public:
+	String callbackId;
+	int timeout;
+	bool highAccuracy;
+	int minimumInterval;
+	float distanceFilter;
+	long long deadline;
+	// Last position sent
+	PositionFix sent;
+};
+
+/*
+ * A single provider serves every watch and request, and only runs while one of them
+ * needs it. While watching, the update interval follows the measured speed and accuracy:
+ * it grows while the device is stationary and shrinks with speed, never below the smallest
+ * minimumInterval of the watches nor beyond half of their shortest timeout.
+ * The QoS policy can lengthen the interval further. Nothing runs while suspended.
+ */
+class GeoLocation: public PhoneGapCommand, ILocationListener, ITimerEventListener {
+public:
+	// Seconds between updates
+	static const int MIN_INTERVAL = 1;
+	static const int DEFAULT_INTERVAL = 5;
+	static const int MAX_INTERVAL = 60;
 private:
 	LocationProvider* locProvider;
-	bool			  watching;
-	String			  callbackId;
 public:
 	GeoLocation();
 	GeoLocation(Web* pWeb);
 	virtual ~GeoLocation();
 public:
-	void StartWatching();
-	void StopWatching();
+	void StartWatching(const String& watchId, PositionWatch* pWatch);
+	void StopWatching(const String& watchId);
 	bool IsWatching();
-	void GetLastKnownLocation();
+	void GetCurrentPosition(const String& callbackId, int maximumAge, int timeout, bool highAccuracy);
 	virtual void OnLocationUpdated(Location& location);
 	virtual void OnProviderStateChanged(LocProviderState newState);
-	virtual void Run(const String& command);
+	virtual void Run(const CommandArgs& args);
+	virtual void Suspend(void);
+	virtual void Resume(void);
+	virtual long ReleaseMemory(void);
+	virtual void ApplyQos(void);
+	void OnTimerExpired(Timer& timer);
+	// Great circle distance in meters
+	static float GetDistance(const PositionFix& from, const PositionFix& to);
+private:
+	bool IsFresh(int maximumAge) const;
+	void Adapt(const PositionFix& fix);
+	void UpdateProvider(void);
+	void ScheduleTimeout(void);
+	void SendPosition(const String& callbackId, const PositionFix& fix);
+	void SendError(const String& callbackId, int code, const mchar* pMessage);
+	static long long GetTicks(void);
+private:
+	PositionFix __fix;
+	ArrayListT<PositionRequest*> __requests;
+	Timer __timeoutTimer;
+	// Method the provider was constructed with, interval it runs at (0 when stopped)
+	bool __highAccuracy;
+	int __interval;
+	// Interval chosen from the last fixes while watching
+	int __adaptiveInterval;
+	HashMapT<String, PositionWatch*> __watches;
+	// The provider and the timeouts are stopped, watches and requests are kept
+	bool __suspended;
 };
 
 #endif /* GEOLOCATION_H_ */
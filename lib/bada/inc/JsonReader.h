@@ -0,0 +1,60 @@
+/*
+ * JsonReader.h
+ *
+ *  Pull reader walking a JSON document one token at a time, without building
+ *  an intermediate tree.
+ */
+
+#ifndef JSONREADER_H_
+#define JSONREADER_H_
+
+#include <FBase.h>
+
+using namespace Osp::Base;
+
+enum JsonToken {
+	JSON_TOKEN_BEGIN_OBJECT,
+	JSON_TOKEN_END_OBJECT,
+	JSON_TOKEN_BEGIN_ARRAY,
+	JSON_TOKEN_END_ARRAY,
+	JSON_TOKEN_NAME,
+	JSON_TOKEN_STRING,
+	JSON_TOKEN_NUMBER,
+	JSON_TOKEN_BOOLEAN,
+	JSON_TOKEN_NULL,
+	JSON_TOKEN_END,
+	JSON_TOKEN_ERROR
+};
+
+/*
+ * The document is not copied: the String given to Construct() must outlive the reader.
+ * Member names are reported as JSON_TOKEN_NAME, separators are consumed silently.
+ */
+class JsonReader {
+public:
+	JsonReader();
+	virtual ~JsonReader();
+	result Construct(const String& json);
+public:
+	JsonToken Next(void);
+	JsonToken GetToken(void) const;
+	const String& GetValue(void) const;
+	result GetInt(int& value) const;
+	result GetDouble(double& value) const;
+	bool GetBool(void) const;
+	result Skip(void);
+private:
+	void SkipWhitespace(void);
+	bool ReadString(void);
+	bool ReadLiteral(const mchar* pLiteral);
+	void ReadNumber(void);
+private:
+	const mchar* __pChars;
+	int __length;
+	int __pos;
+	int __depth;
+	JsonToken __token;
+	String __value;
+};
+
+#endif /* JSONREADER_H_ */
@@ -9,23 +9,66 @@
 #define KAMERA_H_
 
 #include "PhoneGapCommand.h"
+#include "QosPolicy.h"
 #include <FApp.h>
 #include <FIo.h>
+#include <FMedia.h>
+#include <FGraphics.h>
 
 using namespace Osp::App;
 using namespace Osp::Base::Collection;
 using namespace Osp::Io;
+using namespace Osp::Media;
+using namespace Osp::Graphics;
+
+class Kamera;
+
+/*
+ * Moves the captured picture to where the page gets it from, then decodes it at a reduced
+ * size and saves it as a JPEG preview, on the worker thread.
+ */
+class PreviewTask: public WorkerTask {
+public:
+	PreviewTask(Kamera& kamera, const String& callbackId, const String& capturePath, bool saveToPhotoAlbum, int width, int height);
+	virtual ~PreviewTask();
+	void Execute(void);
+	void Complete(void);
+public:
+	String callbackId;
+	String capturePath;
+	bool saveToPhotoAlbum;
+	String path;
+	String previewPath;
+	int width;
+	int height;
+	// Result of storing the picture, then of its preview
+	result stored;
+	result r;
+private:
+	Kamera& __kamera;
+};
 
 class Kamera: public PhoneGapCommand, IAppControlEventListener {
+public:
+	static const int DEFAULT_PREVIEW_SIZE = 320;
 public:
 	Kamera(Web* pWeb);
 	virtual ~Kamera();
 public:
 	String callbackId;
 public:
-	void Run(const String& command);
+	virtual void Run(const CommandArgs& args);
 	void GetPicture();
 	void OnAppControlCompleted (const String &appControlId, const String &operationId, const IList *pResultList);
+	void OnPreviewCompleted(PreviewTask& task);
+	static result StorePicture(const String& capturePath, bool saveToPhotoAlbum, String& path);
+private:
+	static bool IsSameVolume(const String& path1, const String& path2);
+	void SendPicture(const String& callbackId, const String& path, const String& previewPath);
+private:
+	int __targetWidth;
+	int __targetHeight;
+	bool __saveToPhotoAlbum;
 };
 
 #endif /* KAMERA_H_ */
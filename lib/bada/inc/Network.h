@@ -9,6 +9,7 @@
 #define NETWORK_H_
 
 #include "PhoneGapCommand.h"
+#include "ConnectionMonitor.h"
 #include <FNet.h>
 #include <FSystem.h>
 
@@ -16,13 +17,47 @@ using namespace Osp::Net;
 using namespace Osp::Net::Http;
 using namespace Osp::System;
 
-class Network: public PhoneGapCommand, public IHttpTransactionEventListener  {
+/*
+ * Reachability of one host: its pooled session, the probe in flight and the last answer.
+ */
+class HostProbe: public Object {
+public:
+	HostProbe(const String& host);
+	virtual ~HostProbe();
+	bool IsFresh(long long now, int maximumAge) const;
+public:
+	String host;
+	HttpSession* pSession;
+	HttpTransaction* pTransaction;
+	// Callbacks waiting for the probe in flight
+	ArrayListT<String> callbacks;
+	// Last answer, error is E_SUCCESS when the host answered
+	bool valid;
+	result error;
+	int status;
+	int httpCode;
+	long long checkedAt;
+};
+
+/*
+ * Probes are HEAD requests on a session kept per host, concurrent checks of a host
+ * share the probe in flight and answers are reused for a while.
+ * Once the page called watchConnection, connection type changes are pushed to it.
+ */
+class Network: public PhoneGapCommand, public IHttpTransactionEventListener, public IConnectionListener  {
+public:
+	static const int MAX_HOSTS = 8;
+	// Milliseconds an answer is reused, failures are retried sooner
+	static const int REACHABLE_TTL = 30000;
+	static const int UNREACHABLE_TTL = 5000;
 public:
 	Network(Web* pWeb);
 	virtual ~Network();
 public:
-	virtual void Run(const String& command);
-	bool IsReachable(const String& hostAddr, const String& callbackId);
+	virtual void Run(const CommandArgs& args);
+	virtual long ReleaseMemory(void);
+	void IsReachable(const String& uri, const String& callbackId, int maximumAge);
+	void OnConnectionChanged(ConnectionType type);
 public:
 	virtual void 	OnTransactionAborted (HttpSession &httpSession, HttpTransaction &httpTransaction, result r);
 	virtual void 	OnTransactionCertVerificationRequiredN (HttpSession &httpSession, HttpTransaction &httpTransaction, Osp::Base::String *pCert) {};
@@ -31,9 +66,17 @@ public:
 	virtual void 	OnTransactionReadyToRead (HttpSession &httpSession, HttpTransaction &httpTransaction, int availableBodyLen) {};
 	virtual void 	OnTransactionReadyToWrite (HttpSession &httpSession, HttpTransaction &httpTransaction, int recommendedChunkSize) {};
 private:
-	void IsReachable(const String& hostAddr);
-	HttpSession* __pHttpSession;
-	String callbackId;
+	HostProbe* GetProbe(const String& host);
+	HostProbe* FindProbe(const HttpTransaction& httpTransaction);
+	result Submit(HostProbe* pProbe, const String& uri);
+	void Finish(HostProbe* pProbe, result r, int httpCode);
+	void SendStatus(const String& callbackId, const HostProbe* pProbe);
+	void SendConnection(ConnectionType type);
+	static long long GetTicks(void);
+private:
+	HashMapT<String, HostProbe*> __probes;
+	ConnectionMonitor __monitor;
+	bool __watchingConnection;
 };
 
 #endif /* NETWORK_H_ */
@@ -16,18 +16,40 @@ using namespace Osp::System;
 using namespace Osp::Ui;
 using namespace Osp::Ui::Controls;
 using namespace Osp::Uix;
+using namespace Osp::Base::Collection;
+using namespace Osp::Base::Runtime;
 
-class Notification: public PhoneGapCommand {
+/*
+ * Vibrations and beeps are queued as steps played one after the other by a timer,
+ * commands return right away and cancel() drops whatever is still pending.
+ */
+class Notification: public PhoneGapCommand, ITimerEventListener {
+public:
+	static const int BEEP_INTERVAL = 1000;
+	static const int MAX_STEPS = 64;
 public:
 	Notification(Web* pWeb);
 	virtual ~Notification();
 public:
 	String callbackId;
 public:
-	void Run(const String& command);
+	virtual void Run(const CommandArgs& args);
 	void Dialog();
 	void Vibrate(const long milliseconds);
+	void Vibrate(const String& pattern);
 	void Beep(const int count);
+	void Cancel(void);
+	void OnTimerExpired(Timer& timer);
+private:
+	void AddStep(long step);
+	void PlayNextStep(void);
+private:
+	// > 0 vibrate for that many ms, < 0 pause, 0 beep
+	ArrayListT<long> __steps;
+	Timer __stepTimer;
+	bool __playing;
+	Vibrator __vibrator;
+	TouchEffect* __pTouchEffect;
 };
 
 #endif /* NOTIFICATION_H_ */
@@ -7,6 +7,8 @@
 #include <FSystem.h>
 #include <FUi.h>
 
+class WebForm;
+
 /**
  * [WebBasedApp] application must inherit from Application class
  * which provides basic features necessary to define an application.
@@ -56,6 +58,14 @@ public:
 
 	// Called when the screen turns off.
 	void OnScreenOff (void);
+
+private:
+	// Suspends the page while hidden or with the screen off, resumes it once neither holds
+	void UpdateSuspension(void);
+
+	WebForm* __pWebForm;
+	bool __background;
+	bool __screenOff;
 };
 
 #endif	//__PHONEGAP_H__
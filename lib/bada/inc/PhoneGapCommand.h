@@ -10,11 +10,64 @@
 
 #include <FWeb.h>
 #include <FBase.h>
+#include "ResultQueue.h"
+#include "ScriptBuilder.h"
+#include "Worker.h"
 
 using namespace Osp::Web::Controls;
 using namespace Osp::Base;
 using namespace Osp::Base::Utility;
 
+/*
+ * Typed view over a gap://service.method/callbackId/arg1/arg2?key=value command.
+ * Parse() splits and percent-decodes the whole command in a single scan into
+ * buffers that are reused from one command to the next.
+ */
+class CommandArgs {
+public:
+	static const int MAX_ARGS = 16;
+	static const int MAX_OPTIONS = 16;
+public:
+	CommandArgs();
+	virtual ~CommandArgs();
+	result Parse(const String& command);
+	void Clear(void);
+public:
+	const String& GetService(void) const;
+	const String& GetMethod(void) const;
+	const String& GetCallbackId(void) const;
+	bool HasCallback(void) const;
+	int GetCount(void) const;
+	const String& GetString(int index) const;
+	result GetInt(int index, int& value) const;
+	result GetLong(int index, long& value) const;
+	result GetDouble(int index, double& value) const;
+	bool GetBool(int index, bool defaultValue) const;
+	const String& GetOption(const String& key) const;
+	bool HasOption(const String& key) const;
+private:
+	int FindOption(const String& key) const;
+	void Decode(const mchar* pChars, int start, int end, String& decoded);
+private:
+	String __service;
+	String __method;
+	String __callbackId;
+	String __args[MAX_ARGS];
+	String __optionKeys[MAX_OPTIONS];
+	String __optionValues[MAX_OPTIONS];
+	String __empty;
+	int __count;
+	int __optionCount;
+};
+
+// Thread Run() is called on
+enum CommandMode {
+	COMMAND_MODE_UI_THREAD,
+	// On the handler's worker lane. Run() must not use pWeb nor anything created on
+	// the UI thread (e.g. timers), results are delivered by the UI thread
+	COMMAND_MODE_WORKER
+};
+
 class PhoneGapCommand {
 public:
 	PhoneGapCommand();
@@ -22,8 +75,28 @@ public:
 	virtual ~PhoneGapCommand();
 protected:
 	Web* pWeb;
+	ResultQueue* pResults;
+	Worker* pWorker;
+	// Worker lane of this handler, its tasks run in order
+	int lane;
 public:
-	virtual void Run(const String& command) =0;
+	void SetResultQueue(ResultQueue* pResults);
+	void SetWorker(Worker* pWorker, int lane);
+	int GetLane(void) const;
+	virtual CommandMode GetMode(void) const;
+	virtual void Run(const CommandArgs& args) =0;
+	// UI thread, while the application is hidden or the screen is off. Handlers stop what
+	// produces results (sensors, location updates, timers) and keep their watches,
+	// Resume() restarts them. Both do nothing by default.
+	virtual void Suspend(void);
+	virtual void Resume(void);
+	// UI thread, when memory runs low. Drops what can be rebuilt (caches, idle sessions) and
+	// returns the bytes freed, 0 by default or when unknown. Handlers running on a worker
+	// post the release to their lane and report what it freed to the page once done.
+	virtual long ReleaseMemory(void);
+	// UI thread, after the QoS tier changed. Running producers pick up the new limits,
+	// see QosPolicy. Does nothing by default.
+	virtual void ApplyQos(void);
 };
 
 #endif /* PHONEGAPCOMMAND_H_ */
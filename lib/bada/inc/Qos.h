@@ -0,0 +1,27 @@
+/*
+ * Qos.h
+ *
+ *  Lets the page read the quality of service policy and override its tier.
+ */
+
+#ifndef QOS_H_
+#define QOS_H_
+
+#include "PhoneGapCommand.h"
+#include "QosPolicy.h"
+
+class Qos: public PhoneGapCommand {
+public:
+	Qos(Web* pWeb);
+	virtual ~Qos();
+public:
+	virtual void Run(const CommandArgs& args);
+	// {tier, batteryTier, overridden, sensorInterval, locationInterval, previewSize, flushInterval}
+	static void AppendPolicy(ScriptBuilder& script, const QosPolicy& policy);
+private:
+	void SendPolicy(const String& callbackId);
+private:
+	QosPolicy* __pPolicy;
+};
+
+#endif /* QOS_H_ */
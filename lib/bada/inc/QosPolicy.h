@@ -0,0 +1,77 @@
+/*
+ * QosPolicy.h
+ *
+ *  Quality of service the handlers follow, in tiers chosen from the battery level:
+ *  sensor sampling, location update interval, camera preview size and how often
+ *  results are delivered to the page. The page can override the tier.
+ */
+
+#ifndef QOSPOLICY_H_
+#define QOSPOLICY_H_
+
+#include <FBase.h>
+#include <FSystem.h>
+
+using namespace Osp::Base;
+using namespace Osp::System;
+
+enum QosTier {
+	// Whatever the page asks for
+	QOS_TIER_NORMAL,
+	// Battery low
+	QOS_TIER_SAVING,
+	// Battery critical or empty
+	QOS_TIER_CRITICAL,
+	QOS_TIER_COUNT
+};
+
+class QosPolicy;
+
+class IQosListener {
+public:
+	virtual ~IQosListener() {}
+	virtual void OnQosChanged(const QosPolicy& policy) = 0;
+};
+
+/*
+ * Reference counted like the tracer, handlers read the current policy with GetCurrent()
+ * or the static Cap*() helpers, which leave values untouched when there is no policy.
+ * The listener is only called when the effective tier changes.
+ */
+class QosPolicy {
+public:
+	static QosPolicy* GetInstance(void);
+	static void ReleaseInstance(void);
+	static QosPolicy* GetCurrent(void);
+	static const mchar* GetTierName(QosTier tier);
+	static result ParseTier(const String& name, QosTier& tier);
+	// Requested values, raised or lowered to what the current tier allows
+	static long CapSensorInterval(long milliseconds);
+	static int CapLocationInterval(int seconds);
+	static int CapPreviewSize(int pixels);
+public:
+	void SetListener(IQosListener* pListener);
+	void SetBatteryLevel(BatteryLevel level);
+	void SetOverride(QosTier tier);
+	void ClearOverride(void);
+	QosTier GetTier(void) const;
+	QosTier GetBatteryTier(void) const;
+	bool IsOverridden(void) const;
+	// Limits of the current tier, 0 when there is none
+	long GetSensorInterval(void) const;
+	int GetLocationInterval(void) const;
+	int GetPreviewSize(void) const;
+	int GetFlushInterval(void) const;
+private:
+	QosPolicy();
+	virtual ~QosPolicy();
+	void Construct(void);
+	void Update(QosTier previous);
+private:
+	IQosListener* __pListener;
+	QosTier __batteryTier;
+	QosTier __override;
+	bool __overridden;
+};
+
+#endif /* QOSPOLICY_H_ */
@@ -0,0 +1,65 @@
+/*
+ * ResultQueue.h
+ *
+ *  Gathers the callback invocations produced by the commands and delivers them
+ *  to the Web control in a single script evaluation per flush.
+ */
+
+#ifndef RESULTQUEUE_H_
+#define RESULTQUEUE_H_
+
+#include <FBase.h>
+#include <FUi.h>
+#include <FWeb.h>
+
+using namespace Osp::Base;
+using namespace Osp::Base::Runtime;
+using namespace Osp::Ui;
+using namespace Osp::Web::Controls;
+
+/*
+ * Scripts can be enqueued from any thread. Evaluation only happens on the thread that
+ * constructed the queue: other threads ask the owner control for a flush with a
+ * REQUEST_FLUSH user event, which it hands to Flush(). While paused (the page is hidden)
+ * nothing is evaluated, the scripts are delivered together once resumed, unless they
+ * reach MAX_PAUSED_LENGTH: they are delivered to the hidden page then rather than held.
+ */
+class ResultQueue: public ITimerEventListener {
+public:
+	static const RequestId REQUEST_FLUSH = 110;
+	// Characters held while paused before they are delivered anyway
+	static const int MAX_PAUSED_LENGTH = 262144;
+public:
+	ResultQueue();
+	virtual ~ResultQueue();
+	result Construct(Web* pWeb, Control& owner);
+public:
+	void Enqueue(const String& script);
+	void Flush(void);
+	void SetFlushInterval(int milliseconds);
+	int GetFlushInterval(void) const;
+	void SetPaused(bool paused);
+	bool IsPaused(void) const;
+	// Delivers what is pending (unless paused) and shrinks the buffer, returns the bytes freed
+	long Compact(void);
+	void OnTimerExpired(Timer& timer);
+private:
+	bool IsOwnerThread(void) const;
+	void ScheduleFlush(void);
+	void RequestFlush(void);
+private:
+	Web*	__pWeb;
+	Control* __pOwner;
+	Thread*	__pOwnerThread;
+	Mutex	__lock;
+	Timer	__timer;
+	String	__pending;
+	int		__count;
+	int		__flushInterval;
+	bool	__scheduled;
+	bool	__paused;
+	// A flush was asked to the owner and has not happened yet
+	bool	__requested;
+};
+
+#endif /* RESULTQUEUE_H_ */
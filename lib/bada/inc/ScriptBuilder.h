@@ -0,0 +1,81 @@
+/*
+ * ScriptBuilder.h
+ *
+ *  Builds the scripts sent back to the page: escaped string literals, full precision
+ *  numbers and comma handling for objects, arrays and call arguments.
+ */
+
+#ifndef SCRIPTBUILDER_H_
+#define SCRIPTBUILDER_H_
+
+#include <FBase.h>
+
+using namespace Osp::Base;
+
+/*
+ * Builders are recycled through Acquire()/Release() and keep their buffer,
+ * so building a callback does not allocate once the pool is warm. The pool is
+ * shared with the worker threads once InitializePool() has been called, before
+ * they start.
+ *
+ *   ScriptBuilder* pScript = ScriptBuilder::Acquire();
+ *   pScript->BeginCallback(callbackId, L"success").BeginObject().Member(L"x").AppendDouble(x).EndObject().EndCallback();
+ *   pResults->Enqueue(pScript->GetString());
+ *   ScriptBuilder::Release(pScript);
+ */
+class ScriptBuilder {
+public:
+	static const int DEFAULT_CAPACITY = 256;
+	static const int MAX_DEPTH = 32;
+public:
+	ScriptBuilder();
+	virtual ~ScriptBuilder();
+	result Construct(int capacity = DEFAULT_CAPACITY);
+	static result InitializePool(void);
+	static ScriptBuilder* Acquire(void);
+	static void Release(ScriptBuilder* pBuilder);
+	// Deletes the idle builders, returns the bytes their buffers held
+	static long ShrinkPool(void);
+public:
+	ScriptBuilder& Clear(void);
+	const String& GetString(void) const;
+	int GetLength(void) const;
+	// Raw script, no separator is added
+	ScriptBuilder& AppendRaw(const mchar* pScript);
+	ScriptBuilder& AppendRaw(const String& script);
+	// Values, separated by commas inside objects, arrays and calls
+	ScriptBuilder& AppendString(const String& value);
+	ScriptBuilder& AppendString(const mchar* pValue);
+	ScriptBuilder& AppendInt(int value);
+	ScriptBuilder& AppendLong(long long value);
+	ScriptBuilder& AppendDouble(double value);
+	ScriptBuilder& AppendFloat(float value);
+	ScriptBuilder& AppendBool(bool value);
+	ScriptBuilder& AppendNull(void);
+	// Script expression used as a value, e.g. a constant defined by the page
+	ScriptBuilder& AppendExpression(const mchar* pExpression);
+	ScriptBuilder& BeginObject(void);
+	ScriptBuilder& EndObject(void);
+	ScriptBuilder& Member(const mchar* pName);
+	ScriptBuilder& BeginArray(void);
+	ScriptBuilder& EndArray(void);
+	ScriptBuilder& BeginCall(const mchar* pFunction);
+	ScriptBuilder& EndCall(void);
+	// PhoneGap.callbacks['callbackId'].method(...);
+	ScriptBuilder& BeginCallback(const String& callbackId, const mchar* pMethod);
+	ScriptBuilder& EndCallback(void);
+private:
+	void Reserve(int length);
+	void Separate(void);
+	void AppendNumber(const char* pNumber);
+	void AppendEscaped(const mchar* pChars, int length);
+	void Open(mchar ch);
+	void Close(mchar ch);
+private:
+	String __script;
+	int __depth;
+	bool __hasValue[MAX_DEPTH];
+	bool __afterName;
+};
+
+#endif /* SCRIPTBUILDER_H_ */
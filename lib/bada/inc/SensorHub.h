@@ -0,0 +1,58 @@
+/*
+ * SensorHub.h
+ *
+ *  Single SensorManager shared by the sensor handlers. Any number of watchers can
+ *  listen to a sensor type, the sensor runs at the smallest interval they asked for
+ *  and is released when the last of them leaves.
+ */
+
+#ifndef SENSORHUB_H_
+#define SENSORHUB_H_
+
+#include <FBase.h>
+#include <FUix.h>
+
+using namespace Osp::Base;
+using namespace Osp::Base::Collection;
+using namespace Osp::Uix;
+
+class SensorWatcher {
+public:
+	ISensorEventListener* pListener;
+	SensorType type;
+	long interval;
+	long long lastDelivery;
+};
+
+/*
+ * Reference counted: every GetInstance() is paired with a ReleaseInstance().
+ * Watchers asking for a longer interval than the sensor runs at only receive
+ * the samples due to them.
+ */
+class SensorHub: public ISensorEventListener {
+public:
+	static SensorHub* GetInstance(void);
+	static void ReleaseInstance(void);
+public:
+	bool IsAvailable(SensorType type);
+	result AddWatcher(ISensorEventListener& listener, SensorType type, long interval);
+	result RemoveWatcher(ISensorEventListener& listener, SensorType type);
+	bool IsWatching(ISensorEventListener& listener, SensorType type) const;
+	void OnDataReceived(SensorType sensorType, SensorData& sensorData, result r);
+private:
+	SensorHub();
+	virtual ~SensorHub();
+	result Construct(void);
+	int Find(ISensorEventListener& listener, SensorType type) const;
+	long GetInterval(SensorType type) const;
+	result Update(SensorType type);
+	void Compact(void);
+private:
+	SensorManager __sensorMgr;
+	ArrayListT<SensorWatcher*> __watchers;
+	// Interval the sensor is registered with, 0 when it is not running
+	HashMapT<int, long> __intervals;
+	bool __dispatching;
+};
+
+#endif /* SENSORHUB_H_ */
@@ -0,0 +1,50 @@
+/*
+ * Trace.h
+ *
+ *  Exposes the bridge latencies measured by the Tracer to the page, and writes
+ *  them to a file on demand.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "PhoneGapCommand.h"
+#include "Tracer.h"
+#include <FIo.h>
+
+using namespace Osp::Io;
+
+class Trace;
+
+/*
+ * Writes a report to the trace file on the worker thread.
+ */
+class TraceDumpTask: public WorkerTask {
+public:
+	TraceDumpTask(Trace& trace, const String& callbackId, const String& report);
+	virtual ~TraceDumpTask();
+	void Execute(void);
+	void Complete(void);
+public:
+	String callbackId;
+	String report;
+	result r;
+private:
+	Trace& __trace;
+};
+
+class Trace: public PhoneGapCommand {
+public:
+	Trace(Web* pWeb);
+	virtual ~Trace();
+public:
+	virtual void Run(const CommandArgs& args);
+	void OnDumpCompleted(TraceDumpTask& task);
+private:
+	void SendStats(const String& callbackId);
+	void Dump(const String& callbackId);
+private:
+	Tracer* __pTracer;
+};
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,113 @@
+/*
+ * Tracer.h
+ *
+ *  Timestamps every bridged command: when its gap:// URL was requested, when it was
+ *  dispatched, when its handler returned and when its first callback was evaluated.
+ *  Latencies are kept in histograms per service and per service.method.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <FBase.h>
+
+using namespace Osp::Base;
+using namespace Osp::Base::Collection;
+using namespace Osp::Base::Runtime;
+
+enum TraceStage {
+	// Requested -> dispatched: waiting in the Web control and in the batch
+	TRACE_STAGE_QUEUE,
+	// Dispatched -> handler returned
+	TRACE_STAGE_HANDLER,
+	// Handler returned -> first callback evaluated
+	TRACE_STAGE_CALLBACK,
+	// Requested -> first callback evaluated
+	TRACE_STAGE_TOTAL,
+	TRACE_STAGE_COUNT
+};
+
+/*
+ * Millisecond latencies in fixed buckets growing roughly by 25%, percentiles are
+ * reported as the upper bound of their bucket.
+ */
+class LatencyHistogram {
+public:
+	static const int BUCKET_COUNT = 40;
+public:
+	LatencyHistogram();
+	void Add(long long milliseconds);
+	void Clear(void);
+	int GetCount(void) const;
+	long long GetMax(void) const;
+	long long GetPercentile(int percent) const;
+private:
+	int __buckets[BUCKET_COUNT];
+	int __count;
+	long long __max;
+};
+
+class TraceStats: public Object {
+public:
+	TraceStats(const String& name);
+	virtual ~TraceStats();
+public:
+	String name;
+	LatencyHistogram stages[TRACE_STAGE_COUNT];
+};
+
+class TraceRecord {
+public:
+	TraceRecord();
+public:
+	String service;
+	String method;
+	String callbackId;
+	long long requestedAt;
+	long long dispatchedAt;
+	long long handledAt;
+	bool answered;
+};
+
+/*
+ * Reference counted like the sensor hub. The hooks in the bridge (ScriptBuilder,
+ * ResultQueue) use GetCurrent(), which does not take a reference and returns null
+ * when nobody traces. Begin(), End() and Delivered() are called on the UI thread,
+ * Handled() and Answered() also from the workers running handlers.
+ */
+class Tracer {
+public:
+	// Callbacks that are never called (e.g. fail of a successful command) are dropped past this
+	static const int MAX_PENDING = 256;
+public:
+	static Tracer* GetInstance(void);
+	static void ReleaseInstance(void);
+	static Tracer* GetCurrent(void);
+	static long long GetTicks(void);
+public:
+	TraceRecord* Begin(const String& service, const String& method, const String& callbackId, long long requestedAt);
+	void Handled(TraceRecord* pRecord);
+	void End(TraceRecord* pRecord);
+	void Answered(const String& callbackId);
+	void Delivered(void);
+	void Reset(void);
+	IMapEnumeratorT<String, TraceStats*>* GetStatsN(void) const;
+private:
+	Tracer();
+	virtual ~Tracer();
+	result Construct(void);
+	void Add(const TraceRecord& record, TraceStage stage, long long milliseconds);
+	TraceStats* GetStats(const String& name);
+	void ClearPending(void);
+private:
+	Mutex __lock;
+	HashMapT<String, TraceStats*> __stats;
+	// Dispatched, their handler has not returned yet
+	ArrayListT<TraceRecord*> __running;
+	// Handled commands waiting for their first callback, by callback id
+	HashMapT<String, TraceRecord*> __pending;
+	// Answered, waiting for the next evaluation of the result queue
+	ArrayListT<TraceRecord*> __answered;
+};
+
+#endif /* TRACER_H_ */
@@ -7,15 +7,12 @@
 #include <FWeb.h>
 #include <FSystem.h>
 #include "PhoneGapCommand.h"
-#include "GeoLocation.h"
+#include "CommandRegistry.h"
+#include "ResultQueue.h"
+#include "Worker.h"
 #include "Device.h"
-#include "Accelerometer.h"
-#include "Network.h"
-#include "DebugConsole.h"
-#include "Compass.h"
-#include "Contacts.h"
-#include "Notification.h"
-#include "Kamera.h"
+#include "Tracer.h"
+#include "QosPolicy.h"
 
 using namespace Osp::Base;
 using namespace Osp::Base::Collection;
@@ -26,10 +23,35 @@ using namespace Osp::System;
 using namespace Osp::Graphics;
 using namespace Osp::Web::Controls;
 
+// Where the current document is in the PhoneGap start up
+enum PageState {
+	// A document was requested, the native side is not announced to it yet
+	PAGE_LOADING,
+	// window.device is set and onNativeReady fired
+	PAGE_READY
+};
+
+/*
+ * Runs a command on its handler's worker lane, for handlers in COMMAND_MODE_WORKER.
+ * The arguments are copied, the form reuses its own for the next command.
+ */
+class CommandTask: public WorkerTask {
+public:
+	CommandTask(PhoneGapCommand& command, const CommandArgs& args, TraceRecord* pRecord);
+	virtual ~CommandTask();
+	void Execute(void);
+	void Complete(void);
+private:
+	PhoneGapCommand& __command;
+	CommandArgs __args;
+	TraceRecord* __pRecord;
+};
+
 class WebForm :
 	public Osp::Ui::Controls::Form,
 	public Osp::Ui::IActionEventListener,
-	public Osp::Web::Controls::ILoadingListener
+	public Osp::Web::Controls::ILoadingListener,
+	public IQosListener
 {
 
 // Construction
@@ -37,27 +59,42 @@ public:
 	WebForm(void);
 	virtual ~WebForm(void);
 	bool Initialize(void);
+	// The page is hidden: handlers stop producing results and none are evaluated until Resume()
+	void Suspend(void);
+	void Resume(void);
+	bool IsSuspended(void) const;
+	// Memory is low: drops native caches and pooled buffers, asks the Web control and the
+	// page to release theirs. Returns the bytes freed natively on the UI thread
+	long ReleaseMemory(void);
 
 // Implementation
 private:
 	result CreateWebControl(void);
+	void QueueCommands(const String& url);
+	void DispatchCommand(const String& command);
+	void AnnounceNative(void);
+	// The url only moves to another fragment of the loaded document
+	bool IsSameDocument(const String& url) const;
 
 	Osp::Web::Controls::Web*	__pWeb;
-	GeoLocation*                geolocation;
-	Device*						device;
-	Accelerometer*              accel;
-	Network*					network;
-	DebugConsole*				console;
-	Compass*					compass;
-	Contacts*					contacts;
-	Notification*				notification;
-	Kamera*						camera;
-	String*						__phonegapCommand;
+	CommandRegistry*			__pRegistry;
+	ResultQueue*				__pResults;
+	Worker*						__pWorker;
+	ArrayList*					__pCommands;
+	CommandArgs					__args;
+	PageState					__pageState;
+	bool						__suspended;
+	Tracer*						__pTracer;
+	QosPolicy*					__pQos;
+	// When the oldest command waiting for dispatch was requested
+	long long					__requestedAt;
 
 public:
 	virtual result OnInitializing(void);
 	virtual result OnTerminating(void);
 	virtual void OnActionPerformed(const Osp::Ui::Control& source, int actionId);
+	virtual void OnUserEventReceivedN(RequestId requestId, Osp::Base::Collection::IList* pArgs);
+	virtual void OnQosChanged(const QosPolicy& policy);
 
 public:
 	virtual void  OnEstimatedProgress (int progress) {};
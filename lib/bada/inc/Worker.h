@@ -0,0 +1,88 @@
+/*
+ * Worker.h
+ *
+ *  Runs slow work (decoding, encoding, file copies, address book queries) off the UI
+ *  thread. A WorkerTask is executed on a worker thread and completed back on the UI
+ *  thread, where it may use the Web control.
+ */
+
+#ifndef WORKER_H_
+#define WORKER_H_
+
+#include <FBase.h>
+#include <FUi.h>
+
+using namespace Osp::Base;
+using namespace Osp::Base::Collection;
+using namespace Osp::Base::Runtime;
+using namespace Osp::Ui;
+
+class WorkerTask: public Object {
+public:
+	WorkerTask();
+	virtual ~WorkerTask();
+public:
+	// Worker thread: must not touch the Web control
+	virtual void Execute(void) =0;
+	// UI thread, the task is deleted afterwards
+	virtual void Complete(void) =0;
+	bool IsExecuted(void) const;
+private:
+	friend class WorkerThread;
+	bool __executed;
+};
+
+/*
+ * One event driven thread, running its tasks one at a time in the order they were posted.
+ */
+class WorkerThread: public Thread {
+public:
+	WorkerThread();
+	virtual ~WorkerThread();
+	result Construct(Control& owner);
+public:
+	result Post(WorkerTask* pTask);
+	void OnUserEventReceivedN(RequestId requestId, IList* pArgs);
+private:
+	Control* __pOwner;
+};
+
+/*
+ * Pool of worker threads. Tasks are posted to a lane: tasks of the same lane run in order
+ * on the same thread, so a handler posting all its tasks to its own lane never runs two
+ * of them at once. Completion is delivered as a user event to the owner control, which
+ * hands it to Complete(). The worker keeps the tasks it was given until they complete,
+ * Drain() settles those still held once the threads are joined.
+ */
+class Worker {
+public:
+	static const RequestId REQUEST_EXECUTE = 100;
+	static const RequestId REQUEST_COMPLETE = 101;
+	static const int DEFAULT_THREAD_COUNT = 2;
+	static const int MAX_THREAD_COUNT = 4;
+public:
+	Worker();
+	virtual ~Worker();
+	result Construct(Control& owner, int threadCount = DEFAULT_THREAD_COUNT);
+public:
+	result Start(void);
+	void Stop(void);
+	void Join(void);
+	int GetLaneCount(void) const;
+	// Takes ownership of the task unless posting fails
+	result Post(WorkerTask* pTask, int lane = 0);
+	void Complete(IList* pArgs);
+	// UI thread, after Join(): completes the executed tasks whose completion was not
+	// handled yet and deletes those that never ran
+	void Drain(void);
+private:
+	bool Remove(WorkerTask* pTask);
+private:
+	WorkerThread* __threads[MAX_THREAD_COUNT];
+	int __threadCount;
+	// Posted and not completed yet
+	ArrayListT<WorkerTask*> __tasks;
+	Mutex __lock;
+};
+
+#endif /* WORKER_H_ */
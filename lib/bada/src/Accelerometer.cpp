@@ -6,113 +6,300 @@
  */
 
 #include "Accelerometer.h"
+#include "CommandRegistry.h"
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Accelerometer", Accelerometer)
+
+AccelerationWatch::AccelerationWatch(Accelerometer& accelerometer, const String& watchId, const String& callbackId, int frequency)
+	: watchId(watchId), callbackId(callbackId), frequency(frequency), sent(0), __accelerometer(accelerometer) {
+	__timer.Construct(*this);
+}
+
+AccelerationWatch::~AccelerationWatch() {
+	__timer.Cancel();
+}
+
+result
+AccelerationWatch::Start(void) {
+	__timer.Cancel();
+	return __timer.Start(frequency);
+}
+
+void
+AccelerationWatch::Stop(void) {
+	__timer.Cancel();
+}
+
+void
+AccelerationWatch::OnTimerExpired(Timer& timer) {
+	__accelerometer.SendSamples(*this);
+	__timer.Start(frequency);
+}
 
 Accelerometer::Accelerometer() {
-	__sensorMgr.Construct();
-	started = false;
+	__pSensors = SensorHub::GetInstance();
+	__written = 0;
+	__suspended = false;
+	__watches.Construct();
+	__currentCallbacks.Construct();
 }
 
 Accelerometer::Accelerometer(Web* pWeb): PhoneGapCommand(pWeb) {
-	__sensorMgr.Construct();
-	started = false;
-	x = y = z = 0.0;
-	timestamp = 0;
+	__pSensors = SensorHub::GetInstance();
+	__written = 0;
+	__suspended = false;
+	__watches.Construct();
+	__currentCallbacks.Construct();
 }
 
 Accelerometer::~Accelerometer() {
+	IMapEnumeratorT<String, AccelerationWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		AccelerationWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			delete pWatch;
+		}
+		delete pWatches;
+	}
+	__watches.RemoveAll();
+	StopSensor();
+	SensorHub::ReleaseInstance();
 }
 
 void
-Accelerometer::Run(const String& command) {
-	if (!command.IsEmpty()) {
-		Uri commandUri;
-		commandUri.SetUri(command);
-		String method = commandUri.GetHost();
-		StringTokenizer strTok(commandUri.GetPath(), L"/");
-		if(strTok.GetTokenCount() == 1) {
-			strTok.GetNextToken(callbackId);
-			AppLogDebug("Method %S, CallbackId: %S", method.GetPointer(), callbackId.GetPointer());
+Accelerometer::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	AppLogDebug("Method %S, CallbackId: %S", method.GetPointer(), args.GetCallbackId().GetPointer());
+	// Watches are identified by the id returned to the page, older pages do not send one
+	const String& watchId = args.GetCount() > 0 ? args.GetString(0) : args.GetCallbackId();
+	if(method == L"watchAcceleration" && args.HasCallback()) {
+		int frequency = DEFAULT_FREQUENCY;
+		if(args.HasOption(L"frequency") && Integer::Parse(args.GetOption(L"frequency"), frequency) != E_SUCCESS) {
+			frequency = DEFAULT_FREQUENCY;
 		}
-		if(method == L"com.phonegap.Accelerometer.watchAcceleration" && !callbackId.IsEmpty() && !IsStarted()) {
-			StartSensor();
-		}
-		if(method == L"com.phonegap.Accelerometer.clearWatch" && IsStarted()) {
-			StopSensor();
-		}
-		if(method == L"com.phonegap.Accelerometer.getCurrentAcceleration" && !callbackId.IsEmpty() && !IsStarted()) {
-			GetLastAcceleration();
+		Watch(watchId, args.GetCallbackId(), frequency);
+	}
+	if(method == L"clearWatch") {
+		ClearWatch(watchId);
+	}
+	if(method == L"getCurrentAcceleration" && args.HasCallback()) {
+		if(IsStarted() && __written > 0) {
+			GetLastAcceleration(args.GetCallbackId());
+		} else if(StartSensor()) {
+			// Answered by the first sample
+			__currentCallbacks.Add(args.GetCallbackId());
+		} else {
+			Fail(args.GetCallbackId());
 		}
-		AppLogDebug("Acceleration command %S completed", command.GetPointer());
-	} else {
-		AppLogDebug("Can't run empty command");
+	}
+	AppLogDebug("Acceleration command %S completed", method.GetPointer());
+}
+
+void
+Accelerometer::Watch(const String& watchId, const String& callbackId, int frequency) {
+	ClearWatch(watchId);
+	if(!StartSensor()) {
+		Fail(callbackId);
+		return;
+	}
+	// Nothing to batch below the sampling interval
+	AccelerationWatch* pWatch = new AccelerationWatch(*this, watchId, callbackId, frequency < SAMPLE_INTERVAL ? SAMPLE_INTERVAL : frequency);
+	pWatch->sent = __written;
+	__watches.Add(watchId, pWatch);
+	if(!__suspended) {
+		pWatch->Start();
+	}
+	AppLogDebug("Delivering accelerations every %d ms to %S", pWatch->frequency, watchId.GetPointer());
+}
+
+void
+Accelerometer::ClearWatch(const String& watchId) {
+	AccelerationWatch* pWatch = null;
+	if(__watches.GetValue(watchId, pWatch) == E_SUCCESS && pWatch) {
+		__watches.Remove(watchId);
+		delete pWatch;
+	}
+	if(__watches.GetCount() == 0 && __currentCallbacks.GetCount() == 0) {
+		StopSensor();
 	}
 }
 
 bool
 Accelerometer::StartSensor(void) {
-	result r = E_SUCCESS;
-
-	if(__sensorMgr.IsAvailable(SENSOR_TYPE_ACCELERATION)) {
-		r = __sensorMgr.AddSensorListener(*this, SENSOR_TYPE_ACCELERATION, 50, true);
-		if(IsFailed(r)) {
-			return false;
-		}
-	} else {
+	if(IsStarted()) {
+		return true;
+	}
+	if(__suspended) {
+		// Started by Resume()
+		return __pSensors->IsAvailable(SENSOR_TYPE_ACCELERATION);
+	}
+	result r = __pSensors->AddWatcher(*this, SENSOR_TYPE_ACCELERATION, GetSampleInterval());
+	if(IsFailed(r)) {
 		AppLogException("Acceleration sensor is not available");
-		String res;
-		res.Format(256, L"PhoneGap.callbacks['%S'].fail({message:'Acceleration sensor is not available',code:'001'});");
-		pWeb->EvaluateJavascriptN(res);
 		return false;
 	}
-	started = true;
+	// Samples left from a previous watch are stale
+	__written = 0;
 	AppLogDebug("Start Watching Sensor");
 	return true;
 }
 
 bool
 Accelerometer::StopSensor(void) {
-	result r = E_SUCCESS;
-
-	r = __sensorMgr.RemoveSensorListener(*this, SENSOR_TYPE_ACCELERATION);
+	if(!IsStarted()) {
+		return true;
+	}
+	result r = __pSensors->RemoveWatcher(*this, SENSOR_TYPE_ACCELERATION);
 	if(IsFailed(r)) {
 		return false;
 	}
-	started = false;
 	AppLogDebug("Stopped Watching Sensor");
 	return true;
 }
 
+long
+Accelerometer::GetSampleInterval(void) {
+	return QosPolicy::CapSensorInterval(SAMPLE_INTERVAL);
+}
+
+void
+Accelerometer::ApplyQos(void) {
+	if(IsStarted()) {
+		// Updates the interval of our watcher, the ring buffer covers a longer period
+		__pSensors->AddWatcher(*this, SENSOR_TYPE_ACCELERATION, GetSampleInterval());
+	}
+}
+
+void
+Accelerometer::Suspend(void) {
+	if(__suspended) {
+		return;
+	}
+	IMapEnumeratorT<String, AccelerationWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		AccelerationWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			pWatch->Stop();
+		}
+		delete pWatches;
+	}
+	StopSensor();
+	__suspended = true;
+}
+
+void
+Accelerometer::Resume(void) {
+	if(!__suspended) {
+		return;
+	}
+	__suspended = false;
+	if(__watches.GetCount() == 0 && __currentCallbacks.GetCount() == 0) {
+		return;
+	}
+	if(!StartSensor()) {
+		for(int i = 0 ; i < __currentCallbacks.GetCount() ; i++) {
+			String pendingId;
+			__currentCallbacks.GetAt(i, pendingId);
+			Fail(pendingId);
+		}
+		__currentCallbacks.RemoveAll();
+		return;
+	}
+	// Nothing was sampled while suspended, the watches start from the new samples
+	IMapEnumeratorT<String, AccelerationWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		AccelerationWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			pWatch->sent = __written;
+			pWatch->Start();
+		}
+		delete pWatches;
+	}
+}
+
 bool
 Accelerometer::IsStarted() {
-	return started;
+	return __pSensors->IsWatching(*this, SENSOR_TYPE_ACCELERATION);
 }
 
 void
-Accelerometer::GetLastAcceleration() {
-	String res;
-	res.Format(256, L"PhoneGap.callbacks['%S'].success({x:%f,y:%f,z:%f,timestamp:%d});", callbackId.GetPointer(), x, y, z, timestamp);
-	pWeb->EvaluateJavascriptN(res);
-
-	res.Clear();
-	res.Format(256, L"navigator.accelerometer.lastAcceleration = new Acceleration(%f,%f,%f,%d});", x, y, z, timestamp);
-	pWeb->EvaluateJavascriptN(res);
+Accelerometer::Fail(const String& callbackId) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"fail").BeginObject()
+			.Member(L"message").AppendString(L"Acceleration sensor is not available")
+			.Member(L"code").AppendString(L"001")
+			.EndObject().EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
 }
 
 void
-Accelerometer::OnDataReceived(SensorType sensorType, SensorData& sensorData, result r) {
+Accelerometer::GetLastAcceleration(const String& callbackId) {
+	const AccelerationSample& sample = __samples[(__written - 1) % RING_SIZE];
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success").BeginObject()
+			.Member(L"x").AppendFloat(sample.x)
+			.Member(L"y").AppendFloat(sample.y)
+			.Member(L"z").AppendFloat(sample.z)
+			.Member(L"timestamp").AppendLong(sample.timestamp)
+			.EndObject().EndCallback();
+	pResults->Enqueue(pScript->GetString());
 
-	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_TIMESTAMP, timestamp);
-	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_X, x);
-	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_Y, y);
-	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_Z, z);
+	pScript->Clear();
+	pScript->AppendRaw(L"navigator.accelerometer.lastAcceleration = ")
+			.BeginCall(L"new Acceleration").AppendFloat(sample.x).AppendFloat(sample.y).AppendFloat(sample.z).AppendLong(sample.timestamp).EndCall()
+			.AppendRaw(L";");
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
 
-	AppLogDebug("x: %f, y: %f, z: %f timestamp: %d", x, y, z, timestamp);
+void
+Accelerometer::SendSamples(AccelerationWatch& watch) {
+	long long count = __written - watch.sent;
+	if(count <= 0) {
+		return;
+	}
+	// Samples overwritten since the last delivery are lost, the newest ones are kept
+	if(count > RING_SIZE) {
+		AppLogDebug("%d accelerations dropped", (int)(count - RING_SIZE));
+		count = RING_SIZE;
+	}
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCall(L"navigator.accelerometer._samples").AppendString(watch.watchId).AppendString(watch.callbackId).BeginArray();
+	for(long long i = __written - count ; i < __written ; i++) {
+		const AccelerationSample& sample = __samples[i % RING_SIZE];
+		pScript->AppendFloat(sample.x).AppendFloat(sample.y).AppendFloat(sample.z).AppendLong(sample.timestamp);
+	}
+	pScript->EndArray().EndCall().AppendRaw(L";");
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+	watch.sent = __written;
+}
 
-	String res;
-	res.Format(256, L"PhoneGap.callbacks['%S'].success({x:%f,y:%f,z:%f,timestamp:%d});", callbackId.GetPointer(), x, y, z, timestamp);
-	pWeb->EvaluateJavascriptN(res);
+void
+Accelerometer::OnDataReceived(SensorType sensorType, SensorData& sensorData, result r) {
+	AccelerationSample& sample = __samples[__written % RING_SIZE];
+	long timestamp = 0;
+	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_TIMESTAMP, timestamp);
+	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_X, sample.x);
+	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_Y, sample.y);
+	sensorData.GetValue((SensorDataKey)ACCELERATION_DATA_KEY_Z, sample.z);
+	sample.timestamp = timestamp;
+	__written++;
 
-	res.Clear();
-	res.Format(256, L"navigator.accelerometer.lastAcceleration = new Acceleration(%f,%f,%f,%d});", x, y, z, timestamp);
-	pWeb->EvaluateJavascriptN(res);
+	if(__currentCallbacks.GetCount() > 0) {
+		for(int i = 0 ; i < __currentCallbacks.GetCount() ; i++) {
+			String pendingId;
+			__currentCallbacks.GetAt(i, pendingId);
+			GetLastAcceleration(pendingId);
+		}
+		__currentCallbacks.RemoveAll();
+		// The sensor was only started for these requests
+		if(__watches.GetCount() == 0) {
+			StopSensor();
+		}
+	}
 }
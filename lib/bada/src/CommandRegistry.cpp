@@ -0,0 +1,157 @@
+/*
+ * CommandRegistry.cpp
+ *
+ *  Maps a service name (e.g. com.phonegap.Accelerometer) to the PhoneGapCommand
+ *  handling it. Handlers register a factory and are only created on their first command.
+ */
+
+#include "../inc/CommandRegistry.h"
+
+// Filled during static initialization, before any Osp object can safely be constructed,
+// so registrations are kept in a plain table and copied into the hash map by Construct()
+static const int MAX_REGISTERED_COMMANDS = 32;
+
+struct RegisteredCommand {
+	const mchar* service;
+	PhoneGapCommandFactory factory;
+};
+
+static RegisteredCommand __registered[MAX_REGISTERED_COMMANDS];
+static int __registeredCount = 0;
+
+CommandRegistry::CommandRegistry(Web* pWeb, ResultQueue* pResults, Worker* pWorker) : pWeb(pWeb), pResults(pResults), pWorker(pWorker), __nextLane(0) {
+}
+
+CommandRegistry::~CommandRegistry() {
+	IMapEnumeratorT<String, PhoneGapCommand*>* pEnum = __commands.GetMapEnumeratorN();
+	if(pEnum) {
+		PhoneGapCommand* pCommand = null;
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			pEnum->GetValue(pCommand);
+			delete pCommand;
+		}
+		delete pEnum;
+	}
+	__commands.RemoveAll();
+}
+
+result
+CommandRegistry::Construct(void) {
+	result r = __factories.Construct(MAX_REGISTERED_COMMANDS);
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __commands.Construct(MAX_REGISTERED_COMMANDS);
+	if(IsFailed(r)) {
+		return r;
+	}
+	for(int i = 0 ; i < __registeredCount ; i++) {
+		r = __factories.Add(String(__registered[i].service), __registered[i].factory);
+		if(IsFailed(r)) {
+			AppLogException("Could not register %S", __registered[i].service);
+		}
+	}
+	AppLogDebug("%d PhoneGap commands registered", __factories.GetCount());
+	return E_SUCCESS;
+}
+
+bool
+CommandRegistry::Register(const mchar* service, PhoneGapCommandFactory factory) {
+	if(__registeredCount >= MAX_REGISTERED_COMMANDS) {
+		return false;
+	}
+	__registered[__registeredCount].service = service;
+	__registered[__registeredCount].factory = factory;
+	__registeredCount++;
+	return true;
+}
+
+PhoneGapCommand*
+CommandRegistry::GetCommand(const String& service) {
+	PhoneGapCommand* pCommand = null;
+	if(__commands.GetValue(service, pCommand) == E_SUCCESS) {
+		return pCommand;
+	}
+
+	PhoneGapCommandFactory factory = null;
+	if(__factories.GetValue(service, factory) != E_SUCCESS) {
+		AppLogDebug("No command registered for %S", service.GetPointer());
+		return null;
+	}
+
+	// First command for this service: creating its handler
+	pCommand = factory(pWeb);
+	pCommand->SetResultQueue(pResults);
+	pCommand->SetWorker(pWorker, __nextLane++);
+	__commands.Add(service, pCommand);
+	AppLogDebug("Created command for %S", service.GetPointer());
+	return pCommand;
+}
+
+void
+CommandRegistry::DetachWorker(void) {
+	pWorker = null;
+	IMapEnumeratorT<String, PhoneGapCommand*>* pEnum = __commands.GetMapEnumeratorN();
+	if(pEnum) {
+		PhoneGapCommand* pCommand = null;
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			pEnum->GetValue(pCommand);
+			pCommand->SetWorker(null, 0);
+		}
+		delete pEnum;
+	}
+}
+
+void
+CommandRegistry::Suspend(void) {
+	IMapEnumeratorT<String, PhoneGapCommand*>* pEnum = __commands.GetMapEnumeratorN();
+	if(pEnum) {
+		PhoneGapCommand* pCommand = null;
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			pEnum->GetValue(pCommand);
+			pCommand->Suspend();
+		}
+		delete pEnum;
+	}
+}
+
+void
+CommandRegistry::Resume(void) {
+	IMapEnumeratorT<String, PhoneGapCommand*>* pEnum = __commands.GetMapEnumeratorN();
+	if(pEnum) {
+		PhoneGapCommand* pCommand = null;
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			pEnum->GetValue(pCommand);
+			pCommand->Resume();
+		}
+		delete pEnum;
+	}
+}
+
+long
+CommandRegistry::ReleaseMemory(void) {
+	long freed = 0;
+	IMapEnumeratorT<String, PhoneGapCommand*>* pEnum = __commands.GetMapEnumeratorN();
+	if(pEnum) {
+		PhoneGapCommand* pCommand = null;
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			pEnum->GetValue(pCommand);
+			freed += pCommand->ReleaseMemory();
+		}
+		delete pEnum;
+	}
+	return freed;
+}
+
+void
+CommandRegistry::ApplyQos(void) {
+	IMapEnumeratorT<String, PhoneGapCommand*>* pEnum = __commands.GetMapEnumeratorN();
+	if(pEnum) {
+		PhoneGapCommand* pCommand = null;
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			pEnum->GetValue(pCommand);
+			pCommand->ApplyQos();
+		}
+		delete pEnum;
+	}
+}
@@ -5,110 +5,289 @@
  *      Author: Anis Kadri
  */
 
+#include <math.h>
 #include "../inc/Compass.h"
+#include "../inc/CommandRegistry.h"
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Compass", Compass)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Weight of a new sample in the low-pass filter of filtered watches, 1 disables smoothing
+static const float DEFAULT_SMOOTHING = 0.2f;
+
+CompassWatch::CompassWatch(Compass& compass, const String& callbackId, long frequency, float filter, float smoothing)
+	: callbackId(callbackId), frequency(frequency), filter(filter), smoothing(smoothing),
+	  x(0.0f), y(0.0f), z(0.0f), heading(0.0f),
+	  __primed(false), __reported(false), __reportedHeading(0.0f), __compass(compass) {
+}
+
+bool
+CompassWatch::Update(float sampleX, float sampleY, float sampleZ) {
+	// Filtering the field rather than the angle avoids the jump between 359 and 0 degrees
+	if(__primed) {
+		x += smoothing * (sampleX - x);
+		y += smoothing * (sampleY - y);
+		z += smoothing * (sampleZ - z);
+	} else {
+		x = sampleX;
+		y = sampleY;
+		z = sampleZ;
+		__primed = true;
+	}
+	heading = Compass::GetHeading(x, y);
+	if(filter <= 0.0f) {
+		return true;
+	}
+	if(__reported) {
+		float delta = fabsf(heading - __reportedHeading);
+		if(delta > 180.0f) {
+			delta = 360.0f - delta;
+		}
+		if(delta <= filter) {
+			return false;
+		}
+	}
+	__reported = true;
+	__reportedHeading = heading;
+	return true;
+}
+
+CompassWatch::~CompassWatch() {
+}
+
+void
+CompassWatch::OnDataReceived(SensorType sensorType, SensorData& sensorData, result r) {
+	__compass.OnWatchData(*this, sensorData);
+}
 
 Compass::Compass(Web* pWeb) : PhoneGapCommand(pWeb) {
-	__sensorMgr.Construct();
-	started = false;
+	__pSensors = SensorHub::GetInstance();
+	__watches.Construct();
+	__currentCallbacks.Construct();
 	x = y = z = 0.0;
 	timestamp = 0;
+	hasSample = false;
+	__suspended = false;
 }
 
 Compass::~Compass() {
+	IMapEnumeratorT<String, CompassWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		CompassWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			__pSensors->RemoveWatcher(*pWatch, SENSOR_TYPE_MAGNETIC);
+			delete pWatch;
+		}
+		delete pWatches;
+	}
+	__watches.RemoveAll();
+	__pSensors->RemoveWatcher(*this, SENSOR_TYPE_MAGNETIC);
+	SensorHub::ReleaseInstance();
 }
 
 void
-Compass::Run(const String& command) {
-	if (!command.IsEmpty()) {
-		String args;
-		String delim(L"/");
-		command.SubString(String(L"gap://").GetLength(), args);
-		StringTokenizer strTok(args, delim);
-		if(strTok.GetTokenCount() < 2) {
-			AppLogDebug("Not Enough Params");
-			return;
+Compass::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	AppLogDebug("Method %S, callbackId: %S", method.GetPointer(), args.GetCallbackId().GetPointer());
+	const String& watchId = args.GetCount() > 0 ? args.GetString(0) : args.GetCallbackId();
+	if(method == L"watchHeading" && args.HasCallback()) {
+		AppLogDebug("watching compass...");
+		int frequency = DEFAULT_FREQUENCY;
+		if(args.GetInt(1, frequency) != E_SUCCESS) {
+			frequency = DEFAULT_FREQUENCY;
 		}
-		String method;
-		strTok.GetNextToken(method);
-		// Getting callbackId
-		strTok.GetNextToken(callbackId);
-		AppLogDebug("Method %S, callbackId: %S", method.GetPointer(), callbackId.GetPointer());
-		// used to determine callback ID
-		if(method == L"com.phonegap.Compass.watchHeading" && !callbackId.IsEmpty() && !IsStarted()) {
-			AppLogDebug("watching compass...");
-			StartSensor();
+		double filter = 0.0;
+		if(args.HasOption(L"filter") && Double::Parse(args.GetOption(L"filter"), filter) != E_SUCCESS) {
+			filter = 0.0;
 		}
-		if(method == L"com.phonegap.Compass.clearWatch" && !callbackId.IsEmpty() && IsStarted()) {
-			AppLogDebug("stop watching compass...");
-			StopSensor();
+		// Sampled at the page frequency, an unfiltered watch is not smoothed unless asked to
+		double defaultSmoothing = filter > 0.0 ? DEFAULT_SMOOTHING : 1.0;
+		double smoothing = defaultSmoothing;
+		if(args.HasOption(L"smoothing") && (Double::Parse(args.GetOption(L"smoothing"), smoothing) != E_SUCCESS
+				|| smoothing <= 0.0 || smoothing > 1.0)) {
+			smoothing = defaultSmoothing;
 		}
-		if(method == L"com.phonegap.Compass.getCurrentHeading" && !callbackId.IsEmpty() && !IsStarted()) {
-			AppLogDebug("getting current compass...");
-			GetLastHeading();
+		// A filtered watch follows the sensor closely but only reports actual turns
+		Watch(watchId, args.GetCallbackId(), filter > 0.0 ? SAMPLE_INTERVAL : frequency, (float)filter, (float)smoothing);
+	}
+	if(method == L"clearWatch") {
+		AppLogDebug("stop watching compass...");
+		ClearWatch(watchId);
+	}
+	if(method == L"getCurrentHeading" && args.HasCallback()) {
+		AppLogDebug("getting current compass...");
+		if(hasSample && __watches.GetCount() > 0) {
+			GetLastHeading(args.GetCallbackId());
+		} else if(__suspended ? !__pSensors->IsAvailable(SENSOR_TYPE_MAGNETIC)
+				: IsFailed(__pSensors->AddWatcher(*this, SENSOR_TYPE_MAGNETIC, QosPolicy::CapSensorInterval(SAMPLE_INTERVAL)))) {
+			Fail(args.GetCallbackId());
+		} else {
+			// Answered by the first sample
+			__currentCallbacks.Add(args.GetCallbackId());
 		}
-		AppLogDebug("Compass command %S completed", command.GetPointer());
-	} else {
-		AppLogDebug("Can't run empty command");
 	}
+	AppLogDebug("Compass command %S completed", method.GetPointer());
 }
 
-bool
-Compass::StartSensor(void) {
-	result r = E_SUCCESS;
+void
+Compass::Watch(const String& watchId, const String& callbackId, long frequency, float filter, float smoothing) {
+	ClearWatch(watchId);
+	CompassWatch* pWatch = new CompassWatch(*this, callbackId, frequency, filter, smoothing);
+	// While suspended the watch only starts listening on Resume()
+	if(__suspended ? !__pSensors->IsAvailable(SENSOR_TYPE_MAGNETIC)
+			: IsFailed(__pSensors->AddWatcher(*pWatch, SENSOR_TYPE_MAGNETIC, QosPolicy::CapSensorInterval(frequency)))) {
+		AppLogException("Compass sensor is not available");
+		delete pWatch;
+		Fail(callbackId);
+		return;
+	}
+	__watches.Add(watchId, pWatch);
+	AppLogDebug("Start Watching Sensor every %d ms", frequency);
+}
 
-	if(__sensorMgr.IsAvailable(SENSOR_TYPE_MAGNETIC)) {
-		r = __sensorMgr.AddSensorListener(*this, SENSOR_TYPE_MAGNETIC, 50, true);
-		if(IsFailed(r)) {
-			return false;
+void
+Compass::ClearWatch(const String& watchId) {
+	CompassWatch* pWatch = null;
+	if(__watches.GetValue(watchId, pWatch) != E_SUCCESS || pWatch == null) {
+		return;
+	}
+	__pSensors->RemoveWatcher(*pWatch, SENSOR_TYPE_MAGNETIC);
+	__watches.Remove(watchId);
+	delete pWatch;
+	AppLogDebug("Stopped Watching Sensor");
+}
+
+void
+Compass::Suspend(void) {
+	if(__suspended) {
+		return;
+	}
+	IMapEnumeratorT<String, CompassWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		CompassWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			__pSensors->RemoveWatcher(*pWatch, SENSOR_TYPE_MAGNETIC);
 		}
-	} else {
-		AppLogException("Compass sensor is not available");
-		String res;
-		res.Format(256, L"PhoneGap.callbacks['%S'].fail({message:'Magnetic sensor is not available',code:'001'});", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(res);
-		return false;
+		delete pWatches;
 	}
-	started = true;
-	AppLogDebug("Start Watching Sensor");
-	return true;
+	__pSensors->RemoveWatcher(*this, SENSOR_TYPE_MAGNETIC);
+	__suspended = true;
 }
 
-bool
-Compass::StopSensor(void) {
-	result r = E_SUCCESS;
+void
+Compass::Resume(void) {
+	if(!__suspended) {
+		return;
+	}
+	__suspended = false;
+	IMapEnumeratorT<String, CompassWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		CompassWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			if(IsFailed(__pSensors->AddWatcher(*pWatch, SENSOR_TYPE_MAGNETIC, QosPolicy::CapSensorInterval(pWatch->frequency)))) {
+				Fail(pWatch->callbackId);
+			}
+		}
+		delete pWatches;
+	}
+	if(__currentCallbacks.GetCount() > 0 && IsFailed(__pSensors->AddWatcher(*this, SENSOR_TYPE_MAGNETIC, QosPolicy::CapSensorInterval(SAMPLE_INTERVAL)))) {
+		for(int i = 0 ; i < __currentCallbacks.GetCount() ; i++) {
+			String pendingId;
+			__currentCallbacks.GetAt(i, pendingId);
+			Fail(pendingId);
+		}
+		__currentCallbacks.RemoveAll();
+	}
+}
 
-	r = __sensorMgr.RemoveSensorListener(*this, SENSOR_TYPE_MAGNETIC);
-	if(IsFailed(r)) {
-		return false;
+void
+Compass::ApplyQos(void) {
+	if(__suspended) {
+		// Resume() registers the watches with the limits in effect then
+		return;
+	}
+	IMapEnumeratorT<String, CompassWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		CompassWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			__pSensors->AddWatcher(*pWatch, SENSOR_TYPE_MAGNETIC, QosPolicy::CapSensorInterval(pWatch->frequency));
+		}
+		delete pWatches;
 	}
-	started = false;
-	AppLogDebug("Stopped Watching Sensor");
-	return true;
 }
 
-bool
-Compass::IsStarted() {
-	return started;
+void
+Compass::Fail(const String& callbackId) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"fail").BeginObject()
+			.Member(L"message").AppendString(L"Magnetic sensor is not available")
+			.Member(L"code").AppendString(L"001")
+			.EndObject().EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+float
+Compass::GetHeading(float x, float y) {
+	// Device lying flat, y axis towards the top of the screen, clockwise from magnetic north
+	float heading = atan2f(-x, y) * 180.0f / (float)M_PI;
+	return heading < 0.0f ? heading + 360.0f : heading;
 }
 
 void
-Compass::GetLastHeading() {
-	String res;
-	res.Format(256, L"PhoneGap.callbacks['%S'].success({x:%f,y:%f,z:%f,timestamp:%d});", callbackId.GetPointer(), x, y, z, timestamp);
-	pWeb->EvaluateJavascriptN(res);
+Compass::SendHeading(const String& callbackId, float heading, float x, float y, float z) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success").BeginObject()
+			.Member(L"magneticHeading").AppendFloat(heading)
+			.Member(L"x").AppendFloat(x)
+			.Member(L"y").AppendFloat(y)
+			.Member(L"z").AppendFloat(z)
+			.Member(L"timestamp").AppendLong(timestamp)
+			.EndObject().EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
 }
 
 void
-Compass::OnDataReceived(SensorType sensorType, SensorData& sensorData, result r) {
+Compass::GetLastHeading(const String& callbackId) {
+	SendHeading(callbackId, GetHeading(x, y), x, y, z);
+}
 
+void
+Compass::ReadSample(SensorData& sensorData) {
 	sensorData.GetValue((SensorDataKey)MAGNETIC_DATA_KEY_TIMESTAMP, timestamp);
 	sensorData.GetValue((SensorDataKey)MAGNETIC_DATA_KEY_X, x);
 	sensorData.GetValue((SensorDataKey)MAGNETIC_DATA_KEY_Y, y);
 	sensorData.GetValue((SensorDataKey)MAGNETIC_DATA_KEY_Z, z);
+	hasSample = true;
+}
+
+void
+Compass::OnWatchData(CompassWatch& watch, SensorData& sensorData) {
+	ReadSample(sensorData);
+	if(watch.Update(x, y, z)) {
+		SendHeading(watch.callbackId, watch.heading, watch.x, watch.y, watch.z);
+	}
+}
 
+void
+Compass::OnDataReceived(SensorType sensorType, SensorData& sensorData, result r) {
+	ReadSample(sensorData);
 	AppLogDebug("x: %f, y: %f, z: %f timestamp: %d", x, y, z, timestamp);
 
-	String res;
-	res.Format(256, L"PhoneGap.callbacks['%S'].success({x:%f,y:%f,z:%f,timestamp:%d});", callbackId.GetPointer(), x, y, z, timestamp);
-	pWeb->EvaluateJavascriptN(res);
+	for(int i = 0 ; i < __currentCallbacks.GetCount() ; i++) {
+		String pendingId;
+		__currentCallbacks.GetAt(i, pendingId);
+		GetLastHeading(pendingId);
+	}
+	__currentCallbacks.RemoveAll();
+	// Only listening for these requests
+	__pSensors->RemoveWatcher(*this, SENSOR_TYPE_MAGNETIC);
 }
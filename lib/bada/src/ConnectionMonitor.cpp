@@ -0,0 +1,106 @@
+/*
+ * ConnectionMonitor.cpp
+ *
+ *  Keeps the current connection type from the Wi-Fi and telephony network events,
+ *  so it can be read without querying the system and changes are reported as they happen.
+ */
+
+#include "../inc/ConnectionMonitor.h"
+
+ConnectionMonitor::ConnectionMonitor()
+	: __pListener(null), __wifiConnected(false), __dataAvailable(false), __type(CONNECTION_NONE) {
+}
+
+ConnectionMonitor::~ConnectionMonitor() {
+}
+
+result
+ConnectionMonitor::Construct(IConnectionListener& listener) {
+	__pListener = &listener;
+	result r = __wifiManager.Construct(*this);
+	if(IsFailed(r)) {
+		AppLogException("Could not construct Wifi Manager");
+	} else {
+		__wifiConnected = __wifiManager.IsActivated() && __wifiManager.IsConnected();
+	}
+	r = __networkManager.Construct(this);
+	if(IsFailed(r)) {
+		AppLogException("Could not construct Network Manager");
+	} else {
+		NetworkStatus status;
+		if(__networkManager.GetNetworkStatus(status) == E_SUCCESS) {
+			__dataAvailable = status.IsDataServiceAvailable();
+		}
+	}
+	__type = __wifiConnected ? CONNECTION_WIFI : __dataAvailable ? CONNECTION_CELLULAR : CONNECTION_NONE;
+	AppLogDebug("Connection: %S", GetTypeName(__type));
+	return r;
+}
+
+ConnectionType
+ConnectionMonitor::GetType(void) const {
+	return __type;
+}
+
+const mchar*
+ConnectionMonitor::GetTypeName(ConnectionType type) {
+	switch(type) {
+	case CONNECTION_WIFI: return L"wifi";
+	case CONNECTION_CELLULAR: return L"cellular";
+	default: return L"none";
+	}
+}
+
+void
+ConnectionMonitor::Update(void) {
+	// Wi-Fi wins when both are up, it is the one used for data
+	ConnectionType type = __wifiConnected ? CONNECTION_WIFI : __dataAvailable ? CONNECTION_CELLULAR : CONNECTION_NONE;
+	if(type == __type) {
+		return;
+	}
+	AppLogDebug("Connection changed: %S -> %S", GetTypeName(__type), GetTypeName(type));
+	__type = type;
+	if(__pListener) {
+		__pListener->OnConnectionChanged(type);
+	}
+}
+
+void
+ConnectionMonitor::OnWifiActivated(result r) {
+}
+
+void
+ConnectionMonitor::OnWifiDeactivated(result r) {
+	__wifiConnected = false;
+	Update();
+}
+
+void
+ConnectionMonitor::OnWifiConnected(const String& ssid, result r) {
+	__wifiConnected = r == E_SUCCESS;
+	Update();
+}
+
+void
+ConnectionMonitor::OnWifiDisconnected(void) {
+	__wifiConnected = false;
+	Update();
+}
+
+void
+ConnectionMonitor::OnWifiRssiChanged(long rssi) {
+}
+
+void
+ConnectionMonitor::OnWifiScanCompletedN(const IList* pWifiBssInfoList, result r) {
+	if(pWifiBssInfoList) {
+		const_cast<IList*>(pWifiBssInfoList)->RemoveAll(true);
+		delete pWifiBssInfoList;
+	}
+}
+
+void
+ConnectionMonitor::OnTelephonyNetworkStatusChanged(const NetworkStatus& networkStatus) {
+	__dataAvailable = networkStatus.IsDataServiceAvailable();
+	Update();
+}
@@ -0,0 +1,395 @@
+/*
+ * ContactIndex.cpp
+ *
+ *  In-memory search index over the address book: names and emails (lower case)
+ *  and phone numbers (digits only). Built on the first search, then kept up to date
+ *  from the address book change events.
+ */
+
+#include "../inc/ContactIndex.h"
+
+// Bigger change sets (e.g. a sync) drop the index, it is rebuilt on the next search
+static const int MAX_INCREMENTAL_CHANGES = 64;
+
+static void
+AppendLine(String& terms, const String& value) {
+	if(value.IsEmpty()) {
+		return;
+	}
+	String lower;
+	value.ToLower(lower);
+	terms.Append(lower);
+	terms.Append(L'\n');
+}
+
+static void
+AppendDigits(String& digits, const String& value) {
+	const mchar* pChars = value.GetPointer();
+	for(int i = 0 ; i < value.GetLength() ; i++) {
+		if(pChars[i] >= L'0' && pChars[i] <= L'9') {
+			digits.Append(pChars[i]);
+		}
+	}
+}
+
+static bool
+IsSeparator(mchar ch) {
+	return ch == L' ' || ch == L'.' || ch == L'@' || ch == L'-' || ch == L'_';
+}
+
+ContactEntry::ContactEntry(const Contact& contact) : pPhoneNumbers(null), pEmails(null), pUrls(null) {
+	id = contact.GetRecordId();
+	contact.GetValue(CONTACT_PROPERTY_ID_DISPLAY_NAME, displayName);
+	contact.GetValue(CONTACT_PROPERTY_ID_FIRST_NAME, firstName);
+	contact.GetValue(CONTACT_PROPERTY_ID_LAST_NAME, lastName);
+	pPhoneNumbers = contact.GetValuesN(CONTACT_MPROPERTY_ID_PHONE_NUMBERS);
+	pEmails = contact.GetValuesN(CONTACT_MPROPERTY_ID_EMAILS);
+	pUrls = contact.GetValuesN(CONTACT_MPROPERTY_ID_URLS);
+
+	AppendLine(text, displayName);
+	AppendLine(text, firstName);
+	AppendLine(text, lastName);
+	for(int i = 0 ; pEmails && i < pEmails->GetCount() ; i++) {
+		AppendLine(text, static_cast<const Email*>(pEmails->GetAt(i))->GetEmail());
+	}
+	for(int i = 0 ; pPhoneNumbers && i < pPhoneNumbers->GetCount() ; i++) {
+		AppendDigits(digits, static_cast<const PhoneNumber*>(pPhoneNumbers->GetAt(i))->GetPhoneNumber());
+		digits.Append(L'\n');
+	}
+}
+
+ContactEntry::~ContactEntry() {
+	if(pPhoneNumbers) {
+		pPhoneNumbers->RemoveAll(true);
+		delete pPhoneNumbers;
+	}
+	if(pEmails) {
+		pEmails->RemoveAll(true);
+		delete pEmails;
+	}
+	if(pUrls) {
+		pUrls->RemoveAll(true);
+		delete pUrls;
+	}
+}
+
+long
+ContactEntry::GetMemorySize(void) const {
+	long size = sizeof(ContactEntry);
+	size += (displayName.GetLength() + firstName.GetLength() + lastName.GetLength() + text.GetLength() + digits.GetLength()) * sizeof(mchar);
+	if(pPhoneNumbers) {
+		size += pPhoneNumbers->GetCount() * sizeof(PhoneNumber);
+	}
+	if(pEmails) {
+		size += pEmails->GetCount() * sizeof(Email);
+	}
+	if(pUrls) {
+		size += pUrls->GetCount() * sizeof(Url);
+	}
+	return size;
+}
+
+ContactIndex::ContactIndex() : __pAddressbook(null), __built(false) {
+}
+
+ContactIndex::~ContactIndex() {
+	// No more change events once the address book is gone
+	delete __pAddressbook;
+	Clear();
+}
+
+result
+ContactIndex::Construct(void) {
+	result r = __entries.Construct(256);
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __postings.Construct(4096);
+	if(IsFailed(r)) {
+		return r;
+	}
+	__pAddressbook = new Addressbook();
+	r = __pAddressbook->Construct(this);
+	if(IsFailed(r)) {
+		AppLogException("Could not construct Address Book");
+		delete __pAddressbook;
+		__pAddressbook = null;
+	}
+	return r;
+}
+
+Addressbook*
+ContactIndex::GetAddressbook(void) {
+	return __pAddressbook;
+}
+
+ContactEntry*
+ContactIndex::GetEntry(RecordId id) const {
+	ContactEntry* pEntry = null;
+	__entries.GetValue(id, pEntry);
+	return pEntry;
+}
+
+void
+ContactIndex::Clear(void) {
+	IMapEnumeratorT<RecordId, ContactEntry*>* pEntries = __entries.GetMapEnumeratorN();
+	if(pEntries) {
+		ContactEntry* pEntry = null;
+		while(pEntries->MoveNext() == E_SUCCESS) {
+			pEntries->GetValue(pEntry);
+			delete pEntry;
+		}
+		delete pEntries;
+	}
+	__entries.RemoveAll();
+
+	IMapEnumeratorT<String, ArrayListT<RecordId>*>* pPostings = __postings.GetMapEnumeratorN();
+	if(pPostings) {
+		ArrayListT<RecordId>* pIds = null;
+		while(pPostings->MoveNext() == E_SUCCESS) {
+			pPostings->GetValue(pIds);
+			delete pIds;
+		}
+		delete pPostings;
+	}
+	__postings.RemoveAll();
+	__built = false;
+}
+
+void
+ContactIndex::Invalidate(void) {
+	Clear();
+}
+
+long
+ContactIndex::GetMemorySize(void) const {
+	long size = 0;
+	IMapEnumeratorT<RecordId, ContactEntry*>* pEntries = __entries.GetMapEnumeratorN();
+	if(pEntries) {
+		ContactEntry* pEntry = null;
+		while(pEntries->MoveNext() == E_SUCCESS) {
+			pEntries->GetValue(pEntry);
+			size += pEntry->GetMemorySize();
+		}
+		delete pEntries;
+	}
+	IMapEnumeratorT<String, ArrayListT<RecordId>*>* pPostings = __postings.GetMapEnumeratorN();
+	if(pPostings) {
+		String key;
+		ArrayListT<RecordId>* pIds = null;
+		while(pPostings->MoveNext() == E_SUCCESS) {
+			pPostings->GetKey(key);
+			pPostings->GetValue(pIds);
+			size += sizeof(ArrayListT<RecordId>) + key.GetLength() * sizeof(mchar) + pIds->GetCount() * sizeof(RecordId);
+		}
+		delete pPostings;
+	}
+	return size;
+}
+
+result
+ContactIndex::Build(void) {
+	if(__pAddressbook == null) {
+		return E_INVALID_STATE;
+	}
+	IList* pContacts = __pAddressbook->GetAllContactsN();
+	if(pContacts == null) {
+		return GetLastResult();
+	}
+	IEnumerator* pEnum = pContacts->GetEnumeratorN();
+	while(pEnum->MoveNext() == E_SUCCESS) {
+		Add(new ContactEntry(*static_cast<Contact*>(pEnum->GetCurrent())));
+	}
+	delete pEnum;
+	AppLogDebug("Indexed %d contacts", pContacts->GetCount());
+	pContacts->RemoveAll(true);
+	delete pContacts;
+	__built = true;
+	return E_SUCCESS;
+}
+
+void
+ContactIndex::UpdateKey(const String& key, RecordId id, bool add) {
+	ArrayListT<RecordId>* pIds = null;
+	__postings.GetValue(key, pIds);
+	if(add) {
+		if(pIds == null) {
+			pIds = new ArrayListT<RecordId>();
+			pIds->Construct(4);
+			__postings.Add(key, pIds);
+		}
+		// Keys of an entry are added together, a repeated key can only follow itself
+		RecordId last;
+		if(pIds->GetCount() == 0 || pIds->GetAt(pIds->GetCount() - 1, last) != E_SUCCESS || last != id) {
+			pIds->Add(id);
+		}
+	} else if(pIds) {
+		pIds->Remove(id);
+		if(pIds->GetCount() == 0) {
+			__postings.Remove(key);
+			delete pIds;
+		}
+	}
+}
+
+void
+ContactIndex::UpdateKeys(RecordId id, const String& terms, bool add) {
+	// Each term is indexed by the ^prefixes (1 and 2 characters) of its words and by its trigrams
+	const mchar* pChars = terms.GetPointer();
+	int length = terms.GetLength();
+	String key(4);
+	int start = 0;
+	while(start < length) {
+		int end = start;
+		while(end < length && pChars[end] != L'\n') {
+			end++;
+		}
+		for(int i = start ; i < end ; i++) {
+			if(i == start || IsSeparator(pChars[i - 1])) {
+				key.Clear();
+				key.Append(L'^');
+				key.Append(pChars[i]);
+				UpdateKey(key, id, add);
+				if(i + 1 < end) {
+					key.Append(pChars[i + 1]);
+					UpdateKey(key, id, add);
+				}
+			}
+			if(i + 3 <= end) {
+				key.Clear();
+				key.Append(pChars[i]);
+				key.Append(pChars[i + 1]);
+				key.Append(pChars[i + 2]);
+				UpdateKey(key, id, add);
+			}
+		}
+		start = end + 1;
+	}
+}
+
+void
+ContactIndex::Add(ContactEntry* pEntry) {
+	Remove(pEntry->id);
+	__entries.Add(pEntry->id, pEntry);
+	UpdateKeys(pEntry->id, pEntry->text, true);
+	UpdateKeys(pEntry->id, pEntry->digits, true);
+}
+
+void
+ContactIndex::Remove(RecordId id) {
+	ContactEntry* pEntry = null;
+	if(__entries.GetValue(id, pEntry) != E_SUCCESS || pEntry == null) {
+		return;
+	}
+	UpdateKeys(id, pEntry->text, false);
+	UpdateKeys(id, pEntry->digits, false);
+	__entries.Remove(id);
+	delete pEntry;
+}
+
+void
+ContactIndex::Probe(const String& query, bool digits, ArrayListT<ContactEntry*>& hits) {
+	ArrayListT<RecordId>* pIds = null;
+	String key(4);
+	int length = query.GetLength();
+	if(length < 3) {
+		key.Append(L'^');
+		key.Append(query);
+		__postings.GetValue(key, pIds);
+	} else {
+		// The rarest trigram of the query gives the shortest candidate list
+		for(int i = 0 ; i + 3 <= length ; i++) {
+			ArrayListT<RecordId>* pCandidates = null;
+			query.SubString(i, 3, key);
+			if(__postings.GetValue(key, pCandidates) != E_SUCCESS || pCandidates == null) {
+				return;
+			}
+			if(pIds == null || pCandidates->GetCount() < pIds->GetCount()) {
+				pIds = pCandidates;
+			}
+		}
+	}
+	if(pIds == null) {
+		return;
+	}
+
+	// Posting lists hold each contact once, only a second probe can produce duplicates
+	bool unique = hits.GetCount() == 0;
+	for(int i = 0 ; i < pIds->GetCount() ; i++) {
+		RecordId id;
+		ContactEntry* pEntry = null;
+		if(pIds->GetAt(i, id) != E_SUCCESS || __entries.GetValue(id, pEntry) != E_SUCCESS) {
+			continue;
+		}
+		int index;
+		const String& haystack = digits ? pEntry->digits : pEntry->text;
+		if(length >= 3 && haystack.IndexOf(query, 0, index) != E_SUCCESS) {
+			continue;
+		}
+		if(unique || !hits.Contains(pEntry)) {
+			hits.Add(pEntry);
+		}
+	}
+}
+
+result
+ContactIndex::Search(const String& filter, ArrayListT<ContactEntry*>& hits) {
+	if(!__built) {
+		result r = Build();
+		if(IsFailed(r)) {
+			AppLogException("Could not index contacts");
+			return r;
+		}
+	}
+
+	String text;
+	String digits;
+	filter.ToLower(text);
+	text.Trim();
+	if(text.IsEmpty()) {
+		return E_SUCCESS;
+	}
+	AppendDigits(digits, text);
+
+	Probe(text, false, hits);
+	// Mostly digits: also looked up as a phone number, ignoring +, spaces, dashes...
+	if(!digits.IsEmpty() && digits.GetLength() * 2 >= text.GetLength()) {
+		Probe(digits, true, hits);
+	}
+	AppLogDebug("%d contacts matching %S", hits.GetCount(), filter.GetPointer());
+	return E_SUCCESS;
+}
+
+void
+ContactIndex::OnContactsChanged(const IList& contactChangeInfoList) {
+	if(!__built) {
+		return;
+	}
+	if(contactChangeInfoList.GetCount() > MAX_INCREMENTAL_CHANGES) {
+		AppLogDebug("%d contacts changed, dropping index", contactChangeInfoList.GetCount());
+		Clear();
+		return;
+	}
+	IEnumerator* pEnum = contactChangeInfoList.GetEnumeratorN();
+	while(pEnum->MoveNext() == E_SUCCESS) {
+		const ContactChangeInfo* pInfo = static_cast<const ContactChangeInfo*>(pEnum->GetCurrent());
+		RecordId id = pInfo->GetContactId();
+		if(pInfo->GetChangeType() == RECORD_CHANGE_TYPE_REMOVED) {
+			Remove(id);
+			continue;
+		}
+		// Added or updated
+		Contact* pContact = __pAddressbook->GetContactN(id);
+		if(pContact) {
+			Add(new ContactEntry(*pContact));
+			delete pContact;
+		} else {
+			Remove(id);
+		}
+	}
+	delete pEnum;
+}
+
+void
+ContactIndex::OnCategoriesChanged(const IList& categoryChangeInfoList) {
+}
@@ -6,320 +6,321 @@
  */
 
 #include "../inc/Contacts.h"
+#include "../inc/CommandRegistry.h"
 
-Contacts::Contacts(Web* pWeb) : PhoneGapCommand(pWeb) {
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Contacts", Contacts)
+
+IndexReleaseTask::IndexReleaseTask(Contacts& contacts) : __contacts(contacts), __freed(0) {
 }
 
-Contacts::~Contacts() {
+IndexReleaseTask::~IndexReleaseTask() {
 }
 
 void
-Contacts::Run(const String& command) {
-	if(!command.IsEmpty()) {
-		Uri commandUri;
-		commandUri.SetUri(command);
-		String method = commandUri.GetHost();
-		StringTokenizer strTok(commandUri.GetPath(), L"/");
-		if(strTok.GetTokenCount() < 2) {
-			AppLogException("Not enough params");
-			return;
-		}
-		strTok.GetNextToken(callbackId);
-		// Saving a new contact
-		if(method == L"com.phonegap.Contacts.save" && !callbackId.IsEmpty()) {
-			String contactId;
-			strTok.GetNextToken(contactId);
-			int cid = -1;
-			result r = E_SUCCESS;
-			r = Integer::Parse(contactId, cid);
-			if(IsFailed(r)) {
-				AppLogException("Could not retrieve contact ID");
-			}
-			AppLogDebug("Method %S callbackId %S contactId %d", method.GetPointer(), callbackId.GetPointer(), cid);
-			Create(cid);
-		// Finding an exisiting contact by Name/Phone Number/Email
-		} else if(method == L"com.phonegap.Contacts.find" && !callbackId.IsEmpty()) {
-			String filter;
-			strTok.GetNextToken(filter);
-			AppLogDebug("Method %S callbackId %S filter %S", method.GetPointer(), callbackId.GetPointer(), filter.GetPointer());
-			Find(filter);
-		} else if(method == L"com.phonegap.Contacts.remove" && !callbackId.IsEmpty()) {
-			String id;
-			strTok.GetNextToken(id);
-			AppLogDebug("Method %S callbackId %S ID to remove %S", method.GetPointer(), callbackId.GetPointer(), id.GetPointer());
-			Remove(id);
+IndexReleaseTask::Execute(void) {
+	__freed = __contacts.ReleaseIndex();
+}
+
+void
+IndexReleaseTask::Complete(void) {
+	AppLogDebug("Contact index released, %ld bytes freed", __freed);
+	if(__freed > 0) {
+		__contacts.ReportReleased(__freed);
+	}
+}
+
+Contacts::Contacts(Web* pWeb) : PhoneGapCommand(pWeb), __pIndex(null), __pageTimerConstructed(false), __pageSize(DEFAULT_PAGE_SIZE), __next(0), __found(0) {
+	__pending.Construct();
+}
+
+Contacts::~Contacts() {
+	if(__pageTimerConstructed) {
+		__pageTimer.Cancel();
+	}
+	delete __pIndex;
+}
+
+CommandMode
+Contacts::GetMode(void) const {
+	return COMMAND_MODE_WORKER;
+}
+
+ContactIndex*
+Contacts::GetIndex(void) {
+	// The index and its address book are shared by every command, built on the worker
+	// thread so their change events are delivered there
+	if(__pIndex == null) {
+		__pIndex = new ContactIndex();
+		if(IsFailed(__pIndex->Construct())) {
+			delete __pIndex;
+			__pIndex = null;
 		}
+	}
+	return __pIndex;
+}
 
+long
+Contacts::ReleaseMemory(void) {
+	// The index belongs to the worker thread, it is released there
+	IndexReleaseTask* pTask = new IndexReleaseTask(*this);
+	if(pWorker == null || IsFailed(pWorker->Post(pTask, lane))) {
+		delete pTask;
 	}
+	return 0;
 }
 
-void
-Contacts::SetNickname(Contact& contact, const int cid) {
-	String* value = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].nickname", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("nickname: %S", value->GetPointer());
-		contact.SetValue(CONTACT_PROPERTY_ID_NICK_NAME, *value);
+long
+Contacts::ReleaseIndex(void) {
+	if(__pIndex == null || __next < __pending.GetCount()) {
+		// Not built, or still serving the pages of a search
+		return 0;
 	}
-	delete value;
+	long freed = __pIndex->GetMemorySize();
+	__pIndex->Invalidate();
+	return freed;
 }
 
 void
-Contacts::SetFirstName(Contact& contact, const int cid) {
-	String* value = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].name.givenName", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("First Name: %S", value->GetPointer());
-		contact.SetValue(CONTACT_PROPERTY_ID_FIRST_NAME, *value);
-	}
-	delete value;
+Contacts::ReportReleased(long freed) {
+	// Released after the page was told about the rest, it hears about the index separately
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->AppendRaw(L"if(window.PhoneGap)").BeginCall(L"PhoneGap.onLowMemory.fire").BeginObject()
+			.Member(L"freed").AppendLong(freed)
+			.EndObject().EndCall().AppendRaw(L";");
+	String* pResult = pWeb->EvaluateJavascriptN(pScript->GetString());
+	delete pResult;
+	ScriptBuilder::Release(pScript);
 }
 
 void
-Contacts::SetLastName(Contact& contact, const int cid) {
-	String* value = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].name.familyName", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("Last Name: %S", value->GetPointer());
-		contact.SetValue(CONTACT_PROPERTY_ID_LAST_NAME, *value);
+Contacts::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	if(!args.HasCallback() || args.GetCount() < 1) {
+		AppLogException("Not enough params");
+		return;
+	}
+	callbackId = args.GetCallbackId();
+	// Saving a new contact
+	if(method == L"save") {
+		AppLogDebug("Method %S callbackId %S", method.GetPointer(), callbackId.GetPointer());
+		Create(args.GetString(0));
+	// Finding an exisiting contact by Name/Phone Number/Email
+	} else if(method == L"find") {
+		const String& filter = args.GetString(0);
+		int pageSize = 0;
+		if(args.HasOption(L"pageSize")) {
+			Integer::Parse(args.GetOption(L"pageSize"), pageSize);
+		}
+		AppLogDebug("Method %S callbackId %S filter %S", method.GetPointer(), callbackId.GetPointer(), filter.GetPointer());
+		Find(filter, pageSize);
+	} else if(method == L"remove") {
+		const String& id = args.GetString(0);
+		AppLogDebug("Method %S callbackId %S ID to remove %S", method.GetPointer(), callbackId.GetPointer(), id.GetPointer());
+		Remove(id);
 	}
-	delete value;
 }
 
-void
-Contacts::SetPhoneNumbers(Contact& contact, const int cid) {
-	// Getting phone numbers length
-	String* lengthStr = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].phoneNumbers.length", cid);
-	lengthStr = pWeb->EvaluateJavascriptN(eval);
-	if(!lengthStr->IsEmpty()) {
-		int length;
-		result r = Integer::Parse(*lengthStr, length);
-		if(IsFailed(r)) {
-			AppLogException("Could not get phoneNumbers length");
-			return;
+// Reads the next value as a string, nested objects and arrays are skipped
+static bool
+NextString(JsonReader& reader, String& value) {
+	JsonToken token = reader.Next();
+	if(token == JSON_TOKEN_STRING || token == JSON_TOKEN_NUMBER) {
+		value = reader.GetValue();
+		return !value.IsEmpty();
+	}
+	reader.Skip();
+	return false;
+}
+
+// Reads the next member name of the current object, false once the object is closed
+static bool
+NextMember(JsonReader& reader, String& name) {
+	if(reader.Next() != JSON_TOKEN_NAME) {
+		return false;
+	}
+	name = reader.GetValue();
+	return true;
+}
+
+// Reads the next {type:'',value:''} entry of a field list, false once the list is exhausted
+static bool
+NextField(JsonReader& reader, String& type, String& value) {
+	JsonToken token;
+	if(reader.GetToken() == JSON_TOKEN_NAME) {
+		// First entry, the member value has to be an array
+		token = reader.Next();
+		if(token != JSON_TOKEN_BEGIN_ARRAY) {
+			reader.Skip();
+			return false;
 		}
-		delete lengthStr;
-		for(int i = 0 ; i < length ; i++) {
-			String* type = NULL;
-			String* number = NULL;
-
-			// Getting phone number type
-			eval.Clear();
-			eval.Format(128, L"navigator.service.contacts.records[%d].phoneNumbers[%d].type", cid, i);
-			type = pWeb->EvaluateJavascriptN(eval);
-
-			// Getting phone number
-			eval.Clear();
-			eval.Format(128, L"navigator.service.contacts.records[%d].phoneNumbers[%d].value", cid, i);
-			number = pWeb->EvaluateJavascriptN(eval);
-
-			if(!type->IsEmpty() && !number->IsEmpty()) {
-				if(*type == "Home") {
-					AppLogDebug("Adding HOME phone number %S", number->GetPointer());
-					PhoneNumber phoneNumber(PHONENUMBER_TYPE_HOME, *number);
-					contact.AddPhoneNumber(phoneNumber);
-				} else if(*type == "Mobile") {
-					AppLogDebug("Adding MOBILE phone number %S", number->GetPointer());
-					PhoneNumber phoneNumber(PHONENUMBER_TYPE_MOBILE, *number);
-					contact.AddPhoneNumber(phoneNumber);
-				} else if(*type == "Pager") {
-					AppLogDebug("Adding PAGER phone number %S", number->GetPointer());
-					PhoneNumber phoneNumber(PHONENUMBER_TYPE_PAGER, *number);
-					contact.AddPhoneNumber(phoneNumber);
-				} else if(*type == "Work") {
-					AppLogDebug("Adding WORK phone number %S", number->GetPointer());
-					PhoneNumber phoneNumber(PHONENUMBER_TYPE_WORK, *number);
-					contact.AddPhoneNumber(phoneNumber);
-				} else if(*type == "Other") {
-					AppLogDebug("Adding OTHER phone number %S", number->GetPointer());
-					PhoneNumber phoneNumber(PHONENUMBER_TYPE_OTHER, *number);
-					contact.AddPhoneNumber(phoneNumber);
-				}
-			}
-			delete type;
-			delete number;
+	}
+	while((token = reader.Next()) != JSON_TOKEN_BEGIN_OBJECT) {
+		if(token == JSON_TOKEN_END_ARRAY || token == JSON_TOKEN_ERROR || token == JSON_TOKEN_END) {
+			return false;
+		}
+		reader.Skip();
+	}
+	String name;
+	type.Clear();
+	value.Clear();
+	while(NextMember(reader, name)) {
+		if(name == L"type") {
+			NextString(reader, type);
+		} else if(name == L"value") {
+			NextString(reader, value);
+		} else {
+			reader.Next();
+			reader.Skip();
 		}
 	}
+	return true;
 }
 
 void
-Contacts::SetEmails(Contact& contact, const int cid) {
-	// Getting emails length
-	String* lengthStr = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].emails.length", cid);
-	lengthStr = pWeb->EvaluateJavascriptN(eval);
-	if(!lengthStr->IsEmpty()) {
-		int length;
-		result r = Integer::Parse(*lengthStr, length);
-		if(IsFailed(r)) {
-			AppLogException("Could not get emails length");
-			return;
+Contacts::SetName(Contact& contact, JsonReader& reader) {
+	String name, value;
+	if(reader.Next() != JSON_TOKEN_BEGIN_OBJECT) {
+		reader.Skip();
+		return;
+	}
+	while(NextMember(reader, name)) {
+		if(!NextString(reader, value)) {
+			continue;
 		}
-		delete lengthStr;
-		for(int i = 0 ; i < length ; i++) {
-			String* type = NULL;
-			String* address = NULL;
-
-			// Getting email type
-			eval.Clear();
-			eval.Format(128, L"navigator.service.contacts.records[%d].emails[%d].type", cid, i);
-			type = pWeb->EvaluateJavascriptN(eval);
-
-			// Getting email
-			eval.Clear();
-			eval.Format(128, L"navigator.service.contacts.records[%d].emails[%d].value", cid, i);
-			address = pWeb->EvaluateJavascriptN(eval);
-
-			if(!type->IsEmpty() && !address->IsEmpty()) {
-				if(*type == "Personal") {
-					AppLogDebug("Adding PERSONAL email %S", address->GetPointer());
-			        Email email(EMAIL_TYPE_PERSONAL, *address);
-			        contact.AddEmail(email);
-				} else if(*type == "Work") {
-					AppLogDebug("Adding WORK email %S", address->GetPointer());
-			        Email email(EMAIL_TYPE_WORK, *address);
-			        contact.AddEmail(email);
-				} else if(*type == "Other") {
-					AppLogDebug("Adding OTHER email %S", address->GetPointer());
-			        Email email(EMAIL_TYPE_OTHER, *address);
-			        contact.AddEmail(email);
-				}
-			}
-			delete type;
-			delete address;
+		if(name == L"givenName") {
+			AppLogDebug("First Name: %S", value.GetPointer());
+			contact.SetValue(CONTACT_PROPERTY_ID_FIRST_NAME, value);
+		} else if(name == L"familyName") {
+			AppLogDebug("Last Name: %S", value.GetPointer());
+			contact.SetValue(CONTACT_PROPERTY_ID_LAST_NAME, value);
 		}
 	}
 }
 
 void
-Contacts::SetUrls(Contact& contact, const int cid) {
-	// Getting emails length
-	String* lengthStr = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].urls.length", cid);
-	lengthStr = pWeb->EvaluateJavascriptN(eval);
-	if(!lengthStr->IsEmpty()) {
-		int length;
-		result r = Integer::Parse(*lengthStr, length);
-		if(IsFailed(r)) {
-			AppLogException("Could not get urls length");
-			return;
+Contacts::SetPhoneNumbers(Contact& contact, JsonReader& reader) {
+	String type, number;
+	while(NextField(reader, type, number)) {
+		if(type.IsEmpty() || number.IsEmpty()) {
+			continue;
 		}
-		delete lengthStr;
-		for(int i = 0 ; i < length ; i++) {
-			String* type = NULL;
-			String* address = NULL;
-
-			// Getting url type
-			eval.Clear();
-			eval.Format(128, L"navigator.service.contacts.records[%d].urls[%d].type", cid, i);
-			type = pWeb->EvaluateJavascriptN(eval);
-
-			// Getting url
-			eval.Clear();
-			eval.Format(128, L"navigator.service.contacts.records[%d].urls[%d].value", cid, i);
-			address = pWeb->EvaluateJavascriptN(eval);
-
-			if(!type->IsEmpty() && !address->IsEmpty()) {
-				if(*type == "Personal") {
-					AppLogDebug("Adding PERSONAL URL %S", address->GetPointer());
-			        Url url(URL_TYPE_PERSONAL, *address);
-			        contact.AddUrl(url);
-				} else if(*type == "Work") {
-					AppLogDebug("Adding WORK URL %S", address->GetPointer());
-			        Url url(URL_TYPE_WORK, *address);
-			        contact.AddUrl(url);
-				} else if(*type == "Other") {
-					AppLogDebug("Adding OTHER URL %S", address->GetPointer());
-			        Url url(URL_TYPE_OTHER, *address);
-			        contact.AddUrl(url);
-				}
-			}
-			delete type;
-			delete address;
+		if(type == "Home") {
+			AppLogDebug("Adding HOME phone number %S", number.GetPointer());
+			PhoneNumber phoneNumber(PHONENUMBER_TYPE_HOME, number);
+			contact.AddPhoneNumber(phoneNumber);
+		} else if(type == "Mobile") {
+			AppLogDebug("Adding MOBILE phone number %S", number.GetPointer());
+			PhoneNumber phoneNumber(PHONENUMBER_TYPE_MOBILE, number);
+			contact.AddPhoneNumber(phoneNumber);
+		} else if(type == "Pager") {
+			AppLogDebug("Adding PAGER phone number %S", number.GetPointer());
+			PhoneNumber phoneNumber(PHONENUMBER_TYPE_PAGER, number);
+			contact.AddPhoneNumber(phoneNumber);
+		} else if(type == "Work") {
+			AppLogDebug("Adding WORK phone number %S", number.GetPointer());
+			PhoneNumber phoneNumber(PHONENUMBER_TYPE_WORK, number);
+			contact.AddPhoneNumber(phoneNumber);
+		} else if(type == "Other") {
+			AppLogDebug("Adding OTHER phone number %S", number.GetPointer());
+			PhoneNumber phoneNumber(PHONENUMBER_TYPE_OTHER, number);
+			contact.AddPhoneNumber(phoneNumber);
 		}
 	}
 }
 
 void
-Contacts::SetOrganization(Contact& contact, const int cid) {
-	// Setting Organization Name
-	String* value = NULL;
-	String eval;
-	eval.Format(128, L"navigator.service.contacts.records[%d].organization.name", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("Organization Name: %S", value->GetPointer());
-		contact.SetValue(CONTACT_PROPERTY_ID_COMPANY, *value);
-	}
-	delete value;
-
-	// Setting Organization Title
-	eval.Clear();
-	eval.Format(128, L"navigator.service.contacts.records[%d].organization.title", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("Organization Title: %S", value->GetPointer());
-		contact.SetValue(CONTACT_PROPERTY_ID_JOB_TITLE, *value);
-	}
-	delete value;
+Contacts::SetEmails(Contact& contact, JsonReader& reader) {
+	String type, address;
+	while(NextField(reader, type, address)) {
+		if(type.IsEmpty() || address.IsEmpty()) {
+			continue;
+		}
+		if(type == "Personal") {
+			AppLogDebug("Adding PERSONAL email %S", address.GetPointer());
+			Email email(EMAIL_TYPE_PERSONAL, address);
+			contact.AddEmail(email);
+		} else if(type == "Work") {
+			AppLogDebug("Adding WORK email %S", address.GetPointer());
+			Email email(EMAIL_TYPE_WORK, address);
+			contact.AddEmail(email);
+		} else if(type == "Other") {
+			AppLogDebug("Adding OTHER email %S", address.GetPointer());
+			Email email(EMAIL_TYPE_OTHER, address);
+			contact.AddEmail(email);
+		}
+	}
 }
-void
-Contacts::SetBirthday(Contact& contact, const int cid) {
-	String* value;
-	String eval;
-	int year, month, day;
-	DateTime birthday;
 
-	// Setting Year
-	eval.Format(128, L"navigator.service.contacts.records[%d].birthday.getFullYear()", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		result r = Integer::Parse(*value, year);
-		if(IsFailed(r)) {
-			AppLogException("Could not get birthday Year");
-			return;
+void
+Contacts::SetUrls(Contact& contact, JsonReader& reader) {
+	String type, address;
+	while(NextField(reader, type, address)) {
+		if(type.IsEmpty() || address.IsEmpty()) {
+			continue;
+		}
+		if(type == "Personal") {
+			AppLogDebug("Adding PERSONAL URL %S", address.GetPointer());
+			Url url(URL_TYPE_PERSONAL, address);
+			contact.AddUrl(url);
+		} else if(type == "Work") {
+			AppLogDebug("Adding WORK URL %S", address.GetPointer());
+			Url url(URL_TYPE_WORK, address);
+			contact.AddUrl(url);
+		} else if(type == "Other") {
+			AppLogDebug("Adding OTHER URL %S", address.GetPointer());
+			Url url(URL_TYPE_OTHER, address);
+			contact.AddUrl(url);
 		}
-		AppLogDebug("Birthday Year: %S", value->GetPointer());
 	}
-	delete value;
+}
 
-	// Setting Month
-	eval.Clear();
-	eval.Format(128, L"navigator.service.contacts.records[%d].birthday.getMonth() + 1", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		result r = Integer::Parse(*value, month);
-		if(IsFailed(r)) {
-			AppLogException("Could not get birthday Month");
-			return;
+void
+Contacts::SetOrganization(Contact& contact, JsonReader& reader) {
+	String name, value;
+	if(reader.Next() != JSON_TOKEN_BEGIN_OBJECT) {
+		reader.Skip();
+		return;
+	}
+	while(NextMember(reader, name)) {
+		if(!NextString(reader, value)) {
+			continue;
+		}
+		if(name == L"name") {
+			AppLogDebug("Organization Name: %S", value.GetPointer());
+			contact.SetValue(CONTACT_PROPERTY_ID_COMPANY, value);
+		} else if(name == L"title") {
+			AppLogDebug("Organization Title: %S", value.GetPointer());
+			contact.SetValue(CONTACT_PROPERTY_ID_JOB_TITLE, value);
 		}
-		AppLogDebug("Birthday Month: %S", value->GetPointer());
 	}
-	delete value;
+}
 
-	// Setting Day
-	eval.Clear();
-	eval.Format(128, L"navigator.service.contacts.records[%d].birthday.getDate()", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		result r = Integer::Parse(*value, day);
-		if(IsFailed(r)) {
-			AppLogException("Could not get birthday Day");
-			return;
+void
+Contacts::SetBirthday(Contact& contact, JsonReader& reader) {
+	String name, value;
+	int year = 0, month = 0, day = 0;
+	DateTime birthday;
+
+	if(reader.Next() != JSON_TOKEN_BEGIN_OBJECT) {
+		reader.Skip();
+		return;
+	}
+	while(NextMember(reader, name)) {
+		if(!NextString(reader, value)) {
+			continue;
+		}
+		if(name == L"year") {
+			reader.GetInt(year);
+		} else if(name == L"month") {
+			reader.GetInt(month);
+		} else if(name == L"day") {
+			reader.GetInt(day);
 		}
-		AppLogDebug("Birthday Day: %S", value->GetPointer());
 	}
-	delete value;
+	if(year <= 0 || month <= 0 || day <= 0) {
+		AppLogException("Could not get birthday");
+		return;
+	}
 
 	birthday.SetValue(year, month, day);
 	contact.SetValue(CONTACT_PROPERTY_ID_BIRTHDAY, birthday);
@@ -327,257 +328,308 @@ Contacts::SetBirthday(Contact& contact, const int cid) {
 }
 
 void
-Contacts::SetAddress(Contact& contact, const int cid) {
+Contacts::SetAddress(Contact& contact, JsonReader& reader) {
 	Address address;
-	String* value;
-	String eval;
-	// Setting Street Address
-	eval.Format(128, L"navigator.service.contacts.records[%d].address.streetAddress", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("Street Address: %S", value->GetPointer());
-		address.SetStreet(*value);
-	}
-	delete value;
-
-	// Setting City
-	eval.Format(128, L"navigator.service.contacts.records[%d].address.locality", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("City: %S", value->GetPointer());
-		address.SetCity(*value);
-	}
-	delete value;
-
-	// Setting State
-	eval.Format(128, L"navigator.service.contacts.records[%d].address.region", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("State: %S", value->GetPointer());
-		address.SetState(*value);
-	}
-	delete value;
-
-	// Setting Postal Code
-	eval.Format(128, L"navigator.service.contacts.records[%d].address.postalCode", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("Postal Code: %S", value->GetPointer());
-		address.SetPostalCode(*value);
-	}
-	delete value;
-
-	// Setting Country
-	eval.Format(128, L"navigator.service.contacts.records[%d].address.country", cid);
-	value = pWeb->EvaluateJavascriptN(eval);
-	if(!value->IsEmpty()) {
-		AppLogDebug("County: %S", value->GetPointer());
-		address.SetPostalCode(*value);
-	}
-	delete value;
+	String name, value;
+	if(reader.Next() != JSON_TOKEN_BEGIN_OBJECT) {
+		reader.Skip();
+		return;
+	}
+	while(NextMember(reader, name)) {
+		if(!NextString(reader, value)) {
+			continue;
+		}
+		if(name == L"streetAddress") {
+			AppLogDebug("Street Address: %S", value.GetPointer());
+			address.SetStreet(value);
+		} else if(name == L"locality") {
+			AppLogDebug("City: %S", value.GetPointer());
+			address.SetCity(value);
+		} else if(name == L"region") {
+			AppLogDebug("State: %S", value.GetPointer());
+			address.SetState(value);
+		} else if(name == L"postalCode") {
+			AppLogDebug("Postal Code: %S", value.GetPointer());
+			address.SetPostalCode(value);
+		} else if(name == L"country") {
+			AppLogDebug("Country: %S", value.GetPointer());
+			address.SetCountry(value);
+		}
+	}
 
 	contact.AddAddress(address);
 	AppLogDebug("Address Added");
 }
 
+result
+Contacts::SetContact(Contact& contact, const String& json) {
+	JsonReader reader;
+	String name, value;
+
+	result r = reader.Construct(json);
+	if(IsFailed(r) || reader.Next() != JSON_TOKEN_BEGIN_OBJECT) {
+		return E_INVALID_FORMAT;
+	}
+	// Fields are applied as they are read, no intermediate representation is built
+	while(NextMember(reader, name)) {
+		if(name == L"nickname") {
+			if(NextString(reader, value)) {
+				AppLogDebug("nickname: %S", value.GetPointer());
+				contact.SetValue(CONTACT_PROPERTY_ID_NICK_NAME, value);
+			}
+		} else if(name == L"name") {
+			SetName(contact, reader);
+		} else if(name == L"phoneNumbers") {
+			SetPhoneNumbers(contact, reader);
+		} else if(name == L"emails") {
+			SetEmails(contact, reader);
+		} else if(name == L"urls") {
+			SetUrls(contact, reader);
+		} else if(name == L"organization") {
+			SetOrganization(contact, reader);
+		} else if(name == L"birthday") {
+			SetBirthday(contact, reader);
+		} else if(name == L"address") {
+			SetAddress(contact, reader);
+		} else {
+			reader.Next();
+			reader.Skip();
+		}
+	}
+	return reader.GetToken() == JSON_TOKEN_END_OBJECT ? E_SUCCESS : E_INVALID_FORMAT;
+}
+
 void
-Contacts::Create(const int cid) {
+Contacts::Create(const String& json) {
 	result r = E_SUCCESS;
-	Addressbook addressbook;
 
-	r = addressbook.Construct();
-
-	if(IsFailed(r)) {
+	ContactIndex* pIndex = GetIndex();
+	if(pIndex == null) {
 		AppLogException("Could not create AddressBook");
 		return;
 	}
+	Addressbook* pAddressbook = pIndex->GetAddressbook();
 
+	// The record comes serialized with the command
 	Contact contact;
-	SetNickname(contact, cid);
-	SetFirstName(contact, cid);
-	SetLastName(contact, cid);
-	SetPhoneNumbers(contact, cid);
-	SetEmails(contact, cid);
-	SetUrls(contact, cid);
-	SetOrganization(contact, cid);
-	SetBirthday(contact, cid);
-	SetAddress(contact, cid);
-
-	r = addressbook.AddContact(contact);
+	if(json.IsEmpty()) {
+		r = E_OBJ_NOT_FOUND;
+	} else {
+		r = SetContact(contact, json);
+	}
 
-	String eval;
+	if(!IsFailed(r)) {
+		r = pAddressbook->AddContact(contact);
+	}
 
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
 	if(IsFailed(r)) {
 		AppLogException("Could not add contact");
-		eval.Format(128, L"PhoneGap.callbacks['%S'].fail({message:'%s',code:%d})", callbackId.GetPointer(), r, GetErrorMessage(r));
-		pWeb->EvaluateJavascriptN(eval);
+		pScript->BeginCallback(callbackId, L"fail").BeginObject()
+				.Member(L"message").AppendString(String(GetErrorMessage(r)))
+				.Member(L"code").AppendInt(r)
+				.EndObject().EndCallback();
 	} else {
 		AppLogDebug("Contact Successfully Added");
-		eval.Format(128, L"PhoneGap.callbacks['%S'].success({message:'Contact added successfully'})", callbackId.GetPointer());
-		AppLogDebug("%S", eval.GetPointer());
-		pWeb->EvaluateJavascriptN(eval);
+		pScript->BeginCallback(callbackId, L"success").BeginObject()
+				.Member(L"message").AppendString(L"Contact added successfully")
+				.EndObject().EndCallback();
+		AppLogDebug("%S", pScript->GetString().GetPointer());
 	}
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
 }
 
-void
-Contacts::UpdateSearch(Contact* pContact) const {
-	// TODO: update this add other fields too (emails, urls, phonenumbers, etc...)
-	String eval, displayName, firstName, lastName;
-	RecordId recordId = pContact->GetRecordId();
-	LongLong test(recordId);
-	pContact->GetValue(CONTACT_PROPERTY_ID_DISPLAY_NAME, displayName);
-	pContact->GetValue(CONTACT_PROPERTY_ID_FIRST_NAME, firstName);
-	pContact->GetValue(CONTACT_PROPERTY_ID_LAST_NAME, lastName);
-	eval.Format(256, L"navigator.service.contacts._findCallback({id:'%S', displayName:'%S', name:{firstName:'%S',lastName:'%S'}})",
-				test.ToString().GetPointer(),
-				displayName.GetPointer(),
-				firstName.GetPointer(),
-				lastName.GetPointer());
-	//AppLogDebug("%S", eval.GetPointer());
-	pWeb->EvaluateJavascriptN(eval);
+static const mchar*
+GetPhoneNumberType(PhoneNumberType type) {
+	switch(type) {
+	case PHONENUMBER_TYPE_HOME: return L"Home";
+	case PHONENUMBER_TYPE_MOBILE: return L"Mobile";
+	case PHONENUMBER_TYPE_PAGER: return L"Pager";
+	case PHONENUMBER_TYPE_WORK: return L"Work";
+	default: return L"Other";
+	}
 }
 
-void
-Contacts::FindByName(const String& filter) {
-	Addressbook addressbook;
-	Contact* pContact = null;
-	IList* pContactList = null;
-	IEnumerator* pContactEnum = null;
-	String displayName, firstName, lastName;
-
-	result r = addressbook.Construct();
-	if(IsFailed(r))
-	{
-		return;
+static const mchar*
+GetEmailType(EmailType type) {
+	switch(type) {
+	case EMAIL_TYPE_PERSONAL: return L"Personal";
+	case EMAIL_TYPE_WORK: return L"Work";
+	default: return L"Other";
 	}
+}
 
-	// Searching by Email
-	pContactList = addressbook.SearchContactsByNameN(filter);
-	AppLogDebug("Names Matched %d", pContactList->GetCount());
-	pContactEnum = pContactList->GetEnumeratorN();
-	while (E_SUCCESS == pContactEnum->MoveNext())
-	{
-		pContact = (Contact*) pContactEnum->GetCurrent();
-		UpdateSearch(pContact);
+static const mchar*
+GetUrlType(UrlType type) {
+	switch(type) {
+	case URL_TYPE_PERSONAL: return L"Personal";
+	case URL_TYPE_WORK: return L"Work";
+	default: return L"Other";
 	}
-	delete pContactEnum;
-	pContactList->RemoveAll(true);
-	delete pContactList;
 }
+
 void
-Contacts::FindByEmail(const String& filter) {
-	Addressbook addressbook;
-	Contact* pContact = null;
-	IList* pContactList = null;
-	IEnumerator* pContactEnum = null;
-	String displayName, firstName, lastName;
-
-	result r = addressbook.Construct();
-	if(IsFailed(r))
-	{
-		return;
+Contacts::AppendContact(ScriptBuilder& script, const ContactEntry& entry) const {
+	LongLong id(entry.id);
+	script.BeginObject()
+			.Member(L"id").AppendString(id.ToString())
+			.Member(L"displayName").AppendString(entry.displayName)
+			.Member(L"name").BeginObject()
+				.Member(L"givenName").AppendString(entry.firstName)
+				.Member(L"familyName").AppendString(entry.lastName)
+			.EndObject();
+	script.Member(L"phoneNumbers").BeginArray();
+	for(int i = 0 ; entry.pPhoneNumbers && i < entry.pPhoneNumbers->GetCount() ; i++) {
+		const PhoneNumber* pNumber = static_cast<const PhoneNumber*>(entry.pPhoneNumbers->GetAt(i));
+		script.BeginObject()
+				.Member(L"type").AppendString(GetPhoneNumberType(pNumber->GetType()))
+				.Member(L"value").AppendString(pNumber->GetPhoneNumber())
+				.EndObject();
 	}
-
-	// Searching by Email
-	pContactList = addressbook.SearchContactsByEmailN(filter);
-	AppLogDebug("Emails Matched %d", pContactList->GetCount());
-	pContactEnum = pContactList->GetEnumeratorN();
-	while (E_SUCCESS == pContactEnum->MoveNext())
-	{
-		pContact = (Contact*) pContactEnum->GetCurrent();
-		UpdateSearch(pContact);
+	script.EndArray().Member(L"emails").BeginArray();
+	for(int i = 0 ; entry.pEmails && i < entry.pEmails->GetCount() ; i++) {
+		const Email* pEmail = static_cast<const Email*>(entry.pEmails->GetAt(i));
+		script.BeginObject()
+				.Member(L"type").AppendString(GetEmailType(pEmail->GetType()))
+				.Member(L"value").AppendString(pEmail->GetEmail())
+				.EndObject();
+	}
+	script.EndArray().Member(L"urls").BeginArray();
+	for(int i = 0 ; entry.pUrls && i < entry.pUrls->GetCount() ; i++) {
+		const Url* pUrl = static_cast<const Url*>(entry.pUrls->GetAt(i));
+		script.BeginObject()
+				.Member(L"type").AppendString(GetUrlType(pUrl->GetType()))
+				.Member(L"value").AppendString(pUrl->GetUrl())
+				.EndObject();
 	}
-	delete pContactEnum;
-	pContactList->RemoveAll(true);
-	delete pContactList;
+	script.EndArray().EndObject();
 }
+
 void
-Contacts::FindByPhoneNumber(const String& filter) {
-	Addressbook addressbook;
-	Contact* pContact = null;
-	IList* pContactList = null;
-	IEnumerator* pContactEnum = null;
-	String displayName, firstName, lastName;
-
-	result r = addressbook.Construct();
-	if(IsFailed(r))
-	{
+Contacts::SendPage(void) {
+	ContactIndex* pIndex = GetIndex();
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	int count = 0;
+
+	// One evaluation per page
+	pScript->BeginCall(L"navigator.service.contacts._findPage").BeginArray();
+	while(count < __pageSize && __next < __pending.GetCount()) {
+		RecordId id;
+		__pending.GetAt(__next++, id);
+		// The contact may have been removed since the search
+		ContactEntry* pEntry = pIndex ? pIndex->GetEntry(id) : null;
+		if(pEntry == null) {
+			continue;
+		}
+		AppendContact(*pScript, *pEntry);
+		count++;
+	}
+	pScript->EndArray().EndCall().AppendRaw(L";");
+	__found += count;
+	AppLogDebug("Sending %d contacts, %d of %d", count, __next, __pending.GetCount());
+	pResults->Enqueue(pScript->GetString());
+
+	if(__next < __pending.GetCount()) {
+		ScriptBuilder::Release(pScript);
+		pResults->Flush();
+		// Next page after the page has been handed to the UI thread
+		__pageTimer.Start(PAGE_INTERVAL);
 		return;
 	}
-	// Searching by Email
-	pContactList = addressbook.SearchContactsByPhoneNumberN(filter);
-	AppLogDebug("Phone Number Matched %d", pContactList->GetCount());
-	pContactEnum = pContactList->GetEnumeratorN();
-	while (E_SUCCESS == pContactEnum->MoveNext())
-	{
-		pContact = (Contact*) pContactEnum->GetCurrent();
-		UpdateSearch(pContact);
+
+	pScript->Clear();
+	if(__found > 0) {
+		pScript->BeginCallback(__findCallbackId, L"success")
+				.AppendExpression(L"navigator.service.contacts.results")
+				.EndCallback();
+	} else {
+		pScript->BeginCallback(__findCallbackId, L"fail").BeginObject()
+				.Member(L"message").AppendString(L"no contacts found")
+				.Member(L"code").AppendInt(0)
+				.EndObject().EndCallback();
 	}
-	delete pContactEnum;
-	pContactList->RemoveAll(true);
-	delete pContactList;
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+	pResults->Flush();
+	__pending.RemoveAll();
+	__next = 0;
 }
 
 void
-Contacts::Find(const String& filter) {
-	String eval;
-	String* value;
-	int length = 0;
+Contacts::OnTimerExpired(Timer& timer) {
+	if(__next < __pending.GetCount()) {
+		SendPage();
+	}
+}
 
-	// Resetting previous results
-	pWeb->EvaluateJavascriptN(L"navigator.service.contacts.results = new Array();");
-
-	// Searching by Name
-	FindByName(filter);
-	// Searching by PhoneNumber
-	FindByPhoneNumber(filter);
-	// Searching by Email
-	FindByEmail(filter);
-
-	value = pWeb->EvaluateJavascriptN(L"navigator.service.contacts.results.length");
-	AppLogDebug("Results length: %S", value->GetPointer());
-	result r = Integer::Parse(*value, length);
-	if(IsFailed(r)) {
-		AppLogException("Could not get Contact Results Length");
-		return;
+void
+Contacts::Find(const String& filter, int pageSize) {
+	ArrayListT<ContactEntry*> hits;
+	ContactIndex* pIndex = GetIndex();
+
+	if(!__pageTimerConstructed) {
+		__pageTimerConstructed = __pageTimer.Construct(*this) == E_SUCCESS;
 	}
+	// A new search replaces the one being sent
+	__pageTimer.Cancel();
+	__pending.RemoveAll();
+	__next = 0;
+	__found = 0;
+	__pageSize = pageSize > 0 ? pageSize : DEFAULT_PAGE_SIZE;
+	__findCallbackId = callbackId;
 
-	delete value;
-	if(length > 0) {
-		eval.Format(128, L"PhoneGap.callbacks['%S'].success(navigator.service.contacts.results)", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(eval);
-	} else {
-		eval.Format(128, L"PhoneGap.callbacks['%S'].fail({message:'no contacts found',code:00})", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(eval);
+	// Resetting previous results
+	pResults->Enqueue(L"navigator.service.contacts.results = new Array();");
+
+	// Name, phone number and email are matched in a single probe, each contact once
+	hits.Construct();
+	if(pIndex) {
+		pIndex->Search(filter, hits);
+	}
+	for(int i = 0 ; i < hits.GetCount() ; i++) {
+		ContactEntry* pEntry = null;
+		hits.GetAt(i, pEntry);
+		__pending.Add(pEntry->id);
 	}
+
+	AppLogDebug("Results length: %d, page size %d", hits.GetCount(), __pageSize);
+	SendPage();
 }
 
 void
 Contacts::Remove(const String& idStr) {
-	String eval;
-	Addressbook addressbook;
 	RecordId id;
-	result r = addressbook.Construct();
-	if(IsFailed(r))
+	ContactIndex* pIndex = GetIndex();
+	if(pIndex == null)
 	{
 		AppLogException("Could not construct Address Book");
 		return;
 	}
-	r = LongLong::Parse(idStr, id);
+	result r = LongLong::Parse(idStr, id);
 	if(IsFailed(r)) {
 		AppLogException("Could not parse ID");
 	} else {
 		AppLogDebug("Trying to remove contact with ID %S", idStr.GetPointer());
-		r = addressbook.RemoveContact(id);
+		r = pIndex->GetAddressbook()->RemoveContact(id);
+		ScriptBuilder* pScript = ScriptBuilder::Acquire();
 		if(IsFailed(r)) {
 			AppLogDebug("Contact Could not be removed %s %d", GetErrorMessage(r), r);
-			eval.Format(256, L"PhoneGap.callbacks['%S'].fail({message:'%s', code:ContactError.NOT_FOUND_ERROR})",
-															 callbackId.GetPointer(), GetErrorMessage(r));
-			pWeb->EvaluateJavascriptN(eval);
+			pScript->BeginCallback(callbackId, L"fail").BeginObject()
+					.Member(L"message").AppendString(String(GetErrorMessage(r)))
+					.Member(L"code").AppendExpression(L"ContactError.NOT_FOUND_ERROR")
+					.EndObject().EndCallback();
 		} else {
 			AppLogDebug("Contact %S removed", idStr.GetPointer());
-			eval.Format(256, L"PhoneGap.callbacks['%S'].success({message:'Contact with ID %d removed', code:01})", callbackId.GetPointer(), id);
-			pWeb->EvaluateJavascriptN(eval);
+			String message(L"Contact with ID ");
+			message.Append(idStr);
+			message.Append(L" removed");
+			pScript->BeginCallback(callbackId, L"success").BeginObject()
+					.Member(L"message").AppendString(message)
+					.Member(L"code").AppendInt(1)
+					.EndObject().EndCallback();
 		}
+		pResults->Enqueue(pScript->GetString());
+		ScriptBuilder::Release(pScript);
 	}
 }
@@ -5,60 +5,189 @@
  *      Author: Anis Kadri
  */
 
+#include <FSystem.h>
 #include "../inc/DebugConsole.h"
+#include "../inc/CommandRegistry.h"
 
-DebugConsole::DebugConsole(Web* pWeb): PhoneGapCommand(pWeb) {
-	// TODO Auto-generated constructor stub
+using namespace Osp::System;
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.DebugConsole", DebugConsole)
+
+static const mchar* LOG_PATH = L"/Home/phonegap.log";
+// Previous log, replaced at each rotation
+static const mchar* ROTATED_LOG_PATH = L"/Home/phonegap.log.1";
+
+LogFlushTask::LogFlushTask(const String& lines) : __lines(lines) {
 }
 
-DebugConsole::~DebugConsole() {
-	// TODO Auto-generated destructor stub
+LogFlushTask::~LogFlushTask() {
 }
 
 void
-DebugConsole::CleanUp(String& str) {
-	Uri uri;
-	uri.SetUri(str);
-	str.Clear();
-	str.Append(uri.ToString());
+LogFlushTask::Execute(void) {
+	FileAttributes attributes;
+	if(File::GetAttributes(LOG_PATH, attributes) == E_SUCCESS && attributes.GetFileSize() >= DebugConsole::MAX_LOG_SIZE) {
+		File::Remove(ROTATED_LOG_PATH);
+		File::Move(LOG_PATH, ROTATED_LOG_PATH);
+	}
+	File file;
+	result r = file.Construct(LOG_PATH, L"a", true);
+	if(IsFailed(r)) {
+		return;
+	}
+	file.Write(__lines);
 }
 
 void
-DebugConsole::Run(const String& command) {
-	if(!command.IsEmpty()) {
-		String args;
-		String delim(L"/");
-		command.SubString(String(L"gap://").GetLength(), args);
-		StringTokenizer strTok(args, delim);
-		if(strTok.GetTokenCount() < 3) {
-			AppLogDebug("Not enough params");
-			return;
+LogFlushTask::Complete(void) {
+}
+
+DebugConsole::DebugConsole(Web* pWeb): PhoneGapCommand(pWeb),
+	__minLevel(LOG_LEVEL_INFO), __head(0), __count(0), __unflushed(0), __flushScheduled(false) {
+	__flushTimer.Construct(*this);
+}
+
+DebugConsole::~DebugConsole() {
+	__flushTimer.Cancel();
+	Flush();
+}
+
+void
+DebugConsole::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	// Arguments are already URL decoded
+	if(method == L"log") {
+		// [statement, level, statement, level...], the page sends its lines in batches
+		for(int i = 0 ; i + 1 < args.GetCount() ; i += 2) {
+			Log(args.GetString(i), args.GetString(i + 1));
 		}
-		String method;
-		String statement(64);
-		String logLevel;
-		strTok.GetNextToken(method);
-		strTok.GetNextToken(statement);
-		CleanUp(statement);
-		strTok.GetNextToken(logLevel);
-		//AppLogDebug("method %S statement %S loglevel %S", method.GetPointer(), statement.GetPointer(), logLevel.GetPointer());
-		if(method == L"com.phonegap.DebugConsole.log") {
-			Log(statement, logLevel);
+	} else if(method == L"setLevel" && args.GetCount() > 0) {
+		__minLevel = GetLevel(args.GetString(0));
+	} else if(method == L"getLevel" && args.HasCallback()) {
+		ScriptBuilder* pScript = ScriptBuilder::Acquire();
+		pScript->BeginCallback(args.GetCallbackId(), L"success").AppendString(GetLevelName(__minLevel)).EndCallback();
+		pResults->Enqueue(pScript->GetString());
+		ScriptBuilder::Release(pScript);
+	} else if(method == L"dump" && args.HasCallback()) {
+		int count = RING_SIZE;
+		if(args.GetInt(0, count) != E_SUCCESS || count <= 0 || count > RING_SIZE) {
+			count = RING_SIZE;
 		}
+		Dump(args.GetCallbackId(), count);
+	} else if(method == L"flush") {
+		Flush();
+	}
+}
+
+LogLevel
+DebugConsole::GetLevel(const String& name) {
+	if(name == L"DEBUG") {
+		return LOG_LEVEL_DEBUG;
+	} else if(name == L"INFO") {
+		return LOG_LEVEL_INFO;
+	} else if(name == L"WARN") {
+		return LOG_LEVEL_WARN;
+	} else if(name == L"ERROR") {
+		return LOG_LEVEL_ERROR;
+	}
+	return LOG_LEVEL_NONE;
+}
+
+const mchar*
+DebugConsole::GetLevelName(LogLevel level) {
+	switch(level) {
+	case LOG_LEVEL_DEBUG: return L"DEBUG";
+	case LOG_LEVEL_INFO: return L"INFO";
+	case LOG_LEVEL_WARN: return L"WARN";
+	case LOG_LEVEL_ERROR: return L"ERROR";
+	default: return L"NONE";
 	}
 }
 
 void
-DebugConsole::Log(String& statement, String& logLevel) {
-	if(!statement.IsEmpty()) {
-		if(logLevel == L"INFO" || logLevel == L"WARN") {
-			AppLog("[%S] %S", logLevel.GetPointer(), statement.GetPointer());
-		}
-		else if(logLevel == "DEBUG") {
-			AppLogDebug("[%S] %S", logLevel.GetPointer(), statement.GetPointer());
-		}
-		else if(logLevel == L"ERROR") {
-			AppLogException("[%S] %S", logLevel.GetPointer(), statement.GetPointer());
-		}
+DebugConsole::Log(const String& statement, const String& logLevel) {
+	LogLevel level = GetLevel(logLevel);
+	if(statement.IsEmpty() || level < __minLevel || level == LOG_LEVEL_NONE) {
+		return;
 	}
+	// Compiled out of release builds, which only get the file
+	AppLogDebug("[%S] %S", logLevel.GetPointer(), statement.GetPointer());
+
+	long long ticks = 0;
+	SystemTime::GetTicks(ticks);
+	String& line = __ring[__head];
+	line.Clear();
+	line.Append(ticks);
+	line.Append(L" [");
+	line.Append(logLevel);
+	line.Append(L"] ");
+	line.Append(statement);
+	__head = (__head + 1) % RING_SIZE;
+	if(__count < RING_SIZE) {
+		__count++;
+	}
+	__unflushed++;
+
+	if(__unflushed >= FLUSH_LINES || level == LOG_LEVEL_ERROR) {
+		Flush();
+	} else if(!__flushScheduled) {
+		__flushScheduled = __flushTimer.Start(FLUSH_INTERVAL) == E_SUCCESS;
+	}
+}
+
+void
+DebugConsole::Flush(void) {
+	__flushTimer.Cancel();
+	__flushScheduled = false;
+	if(__unflushed == 0) {
+		return;
+	}
+	String lines(1024);
+	int pending = __unflushed;
+	if(pending > __count) {
+		// Overwritten in the ring before they could be written
+		lines.Append(L"... ");
+		lines.Append(pending - __count);
+		lines.Append(L" lines dropped\n");
+		pending = __count;
+	}
+	for(int i = pending ; i > 0 ; i--) {
+		lines.Append(__ring[(__head - i + RING_SIZE) % RING_SIZE]);
+		lines.Append(L'\n');
+	}
+	__unflushed = 0;
+
+	LogFlushTask* pTask = new LogFlushTask(lines);
+	if(pWorker == null || IsFailed(pWorker->Post(pTask, lane))) {
+		// No worker (detached on exit) or it could not take the task, the lines are written here
+		pTask->Execute();
+		delete pTask;
+	}
+}
+
+void
+DebugConsole::Dump(const String& callbackId, int count) {
+	if(count > __count) {
+		count = __count;
+	}
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success").BeginArray();
+	for(int i = count ; i > 0 ; i--) {
+		pScript->AppendString(__ring[(__head - i + RING_SIZE) % RING_SIZE]);
+	}
+	pScript->EndArray().EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+void
+DebugConsole::Suspend(void) {
+	// A hidden application may be killed without notice, its last lines are written now
+	Flush();
+}
+
+void
+DebugConsole::OnTimerExpired(Timer& timer) {
+	__flushScheduled = false;
+	Flush();
 }
@@ -6,6 +6,9 @@
  */
 
 #include "../inc/Device.h"
+#include "../inc/CommandRegistry.h"
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Device", Device)
 
 Device::Device() {
 	// TODO Auto-generated constructor stub
@@ -21,12 +24,20 @@ Device::~Device() {
 }
 
 void
-Device::Run(const String& command) {
+Device::Run(const CommandArgs& args) {
+
+}
 
+const String&
+Device::GetDeviceScript(void) {
+	if(__deviceScript.IsEmpty()) {
+		BuildDeviceScript();
+	}
+	return __deviceScript;
 }
 
 result
-Device::SetDeviceInfo() {
+Device::BuildDeviceScript(void) {
 	result r = E_SUCCESS;
 	String platformVersion;
 	String apiVersion;
@@ -51,10 +62,17 @@ Device::SetDeviceInfo() {
     TryCatch(r == E_SUCCESS, , "SystemInfo: To get a value is failed");
 
     if(r == E_SUCCESS) {
-    	String res;
-    	res.Format(1024, L"window.device={platform:'bada',version:'%S',name:'n/a',phonegap:'1.4.1',uuid:'%S'}", platformVersion.GetPointer(), imei.GetPointer());
-    	//AppLogDebug("%S", res.GetPointer());
-    	pWeb->EvaluateJavascriptN(res);
+    	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+    	pScript->AppendRaw(L"window.device=").BeginObject()
+    			.Member(L"platform").AppendString(L"bada")
+    			.Member(L"version").AppendString(platformVersion)
+    			.Member(L"name").AppendString(L"n/a")
+    			.Member(L"phonegap").AppendString(L"1.4.1")
+    			.Member(L"uuid").AppendString(imei)
+    			.EndObject().AppendRaw(L";");
+    	//AppLogDebug("%S", pScript->GetString().GetPointer());
+    	__deviceScript = pScript->GetString();
+    	ScriptBuilder::Release(pScript);
     }
     return r;
 
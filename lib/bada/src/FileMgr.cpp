@@ -0,0 +1,348 @@
+/*
+ * FileMgr.cpp
+ *
+ *  Reads and writes files for the page in bounded chunks: reads are sent one chunk
+ *  per timer tick through the success callback, data URLs are base64 encoded chunk
+ *  by chunk, writes are converted to UTF-8 a slice at a time.
+ */
+
+#include <string.h>
+#include "../inc/FileMgr.h"
+#include "../inc/CommandRegistry.h"
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.File", FileMgr)
+
+FileRead::FileRead() : pEncoding(null), utf8(false), total(0), loaded(0), carry(0) {
+}
+
+FileRead::~FileRead() {
+	delete pEncoding;
+}
+
+FileMgr::FileMgr(Web* pWeb) : PhoneGapCommand(pWeb), __suspended(false) {
+	__reads.Construct();
+	__chunkTimer.Construct(*this);
+	__bytes.Construct(CHUNK_SIZE + 4);
+}
+
+FileMgr::~FileMgr() {
+	__chunkTimer.Cancel();
+	for(int i = 0 ; i < __reads.GetCount() ; i++) {
+		FileRead* pRead = null;
+		__reads.GetAt(i, pRead);
+		delete pRead;
+	}
+	__reads.RemoveAll();
+}
+
+void
+FileMgr::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	if(!args.HasCallback()) {
+		AppLogException("No callback for %S", method.GetPointer());
+		return;
+	}
+	const String& callbackId = args.GetCallbackId();
+	AppLogDebug("Method %S, callbackId: %S", method.GetPointer(), callbackId.GetPointer());
+	if(method == L"readAsText") {
+		Read(callbackId, args.GetString(0), args.GetString(1), false);
+	} else if(method == L"readAsDataURL") {
+		Read(callbackId, args.GetString(0), L"", true);
+	} else if(method == L"write") {
+		long long position = 0;
+		if(LongLong::Parse(args.GetString(2), position) != E_SUCCESS || position < 0) {
+			position = 0;
+		}
+		Write(callbackId, args.GetString(0), args.GetString(1), position);
+	} else if(method == L"truncate") {
+		long long size = 0;
+		if(LongLong::Parse(args.GetString(1), size) != E_SUCCESS || size < 0) {
+			Fail(callbackId, FILE_ERROR_INVALID_STATE);
+			return;
+		}
+		Truncate(callbackId, args.GetString(0), size);
+	}
+}
+
+String
+FileMgr::GetPath(const String& fileName) {
+	String path(fileName);
+	if(path.StartsWith(L"file://", 0)) {
+		path.Remove(0, 7);
+	}
+	return path;
+}
+
+const mchar*
+FileMgr::GetMimeType(const String& path) {
+	String extension;
+	String lower;
+	path.ToLower(lower);
+	int dot = -1;
+	if(lower.LastIndexOf(L'.', lower.GetLength() - 1, dot) != E_SUCCESS) {
+		return L"application/octet-stream";
+	}
+	lower.SubString(dot + 1, extension);
+	if(extension == L"jpg" || extension == L"jpeg") {
+		return L"image/jpeg";
+	} else if(extension == L"png") {
+		return L"image/png";
+	} else if(extension == L"gif") {
+		return L"image/gif";
+	} else if(extension == L"bmp") {
+		return L"image/bmp";
+	} else if(extension == L"txt") {
+		return L"text/plain";
+	} else if(extension == L"html" || extension == L"htm") {
+		return L"text/html";
+	} else if(extension == L"css") {
+		return L"text/css";
+	} else if(extension == L"js") {
+		return L"application/javascript";
+	} else if(extension == L"json") {
+		return L"application/json";
+	} else if(extension == L"mp3") {
+		return L"audio/mpeg";
+	} else if(extension == L"mp4") {
+		return L"video/mp4";
+	}
+	return L"application/octet-stream";
+}
+
+int
+FileMgr::GetErrorCode(result r, int defaultCode) {
+	switch(r) {
+	case E_FILE_NOT_FOUND:
+		return FILE_ERROR_NOT_FOUND;
+	case E_ILLEGAL_ACCESS:
+		return FILE_ERROR_SECURITY;
+	default:
+		return defaultCode;
+	}
+}
+
+void
+FileMgr::Succeed(const String& callbackId, long long value) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success").AppendLong(value).EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+void
+FileMgr::Fail(const String& callbackId, int code) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"fail").AppendInt(code).EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+void
+FileMgr::Read(const String& callbackId, const String& fileName, const String& encoding, bool dataUrl) {
+	FileRead* pRead = new FileRead();
+	pRead->callbackId = callbackId;
+	pRead->path = GetPath(fileName);
+
+	FileAttributes attributes;
+	result r = File::GetAttributes(pRead->path, attributes);
+	if(!IsFailed(r)) {
+		pRead->total = attributes.GetFileSize();
+		r = pRead->file.Construct(pRead->path, L"r");
+	}
+	if(IsFailed(r)) {
+		AppLogException("Could not open %S", pRead->path.GetPointer());
+		Fail(callbackId, GetErrorCode(r, FILE_ERROR_NOT_READABLE));
+		delete pRead;
+		return;
+	}
+	if(!dataUrl) {
+		String type(encoding.IsEmpty() ? String(L"UTF-8") : encoding);
+		type.ToUpper();
+		pRead->utf8 = type == L"UTF-8" || type == L"UTF8";
+		pRead->pEncoding = Encoding::GetEncodingN(type);
+		if(pRead->pEncoding == null) {
+			AppLogException("Unsupported encoding %S", type.GetPointer());
+			Fail(callbackId, FILE_ERROR_ENCODING);
+			delete pRead;
+			return;
+		}
+	}
+	__reads.Add(pRead);
+	if(__reads.GetCount() == 1 && !__suspended) {
+		__chunkTimer.Start(CHUNK_INTERVAL);
+	}
+}
+
+void
+FileMgr::Suspend(void) {
+	// Chunks would pile up in the paused result queue
+	__chunkTimer.Cancel();
+	__suspended = true;
+}
+
+void
+FileMgr::Resume(void) {
+	__suspended = false;
+	if(__reads.GetCount() > 0) {
+		__chunkTimer.Start(CHUNK_INTERVAL);
+	}
+}
+
+bool
+FileMgr::SendChunk(FileRead& read) {
+	memcpy(__buffer, read.carried, read.carry);
+	int length = read.file.Read(__buffer + read.carry, CHUNK_SIZE);
+	result r = GetLastResult();
+	if(IsFailed(r) && r != E_END_OF_FILE) {
+		AppLogException("Could not read %S", read.path.GetPointer());
+		Fail(read.callbackId, FILE_ERROR_NOT_READABLE);
+		return true;
+	}
+	if(length < 0) {
+		length = 0;
+	}
+	read.loaded += length;
+	bool done = length == 0 || read.loaded >= read.total;
+
+	int usable = read.carry + length;
+	read.carry = 0;
+	if(read.utf8 && !done) {
+		// Keep an incomplete trailing sequence for the next chunk
+		for(int i = usable - 1 ; i >= 0 && i >= usable - 3 ; i--) {
+			byte lead = __buffer[i];
+			if((lead & 0xC0) == 0x80) {
+				continue;
+			}
+			int expected = (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 1;
+			if(i + expected > usable) {
+				read.carry = usable - i;
+				memcpy(read.carried, __buffer + i, read.carry);
+				usable = i;
+			}
+			break;
+		}
+	}
+
+	String data;
+	if(usable > 0) {
+		__bytes.Clear();
+		__bytes.SetArray(__buffer, 0, usable);
+		__bytes.Flip();
+		r = read.pEncoding ? read.pEncoding->GetString(__bytes, data) : StringUtil::EncodeToBase64String(__bytes, data);
+		if(IsFailed(r)) {
+			AppLogException("Could not encode %S", read.path.GetPointer());
+			Fail(read.callbackId, FILE_ERROR_ENCODING);
+			return true;
+		}
+	}
+	if(read.pEncoding == null && read.loaded == length) {
+		String prefix(L"data:");
+		prefix.Append(GetMimeType(read.path));
+		prefix.Append(L";base64,");
+		data.Insert(prefix, 0);
+	}
+
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(read.callbackId, L"success").BeginObject()
+			.Member(L"data").AppendString(data)
+			.Member(L"loaded").AppendLong(read.loaded)
+			.Member(L"total").AppendLong(read.total)
+			.Member(L"done").AppendBool(done)
+			.EndObject().EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+	if(done) {
+		AppLogDebug("Read %d bytes of %S", (int)read.loaded, read.path.GetPointer());
+	}
+	return done;
+}
+
+void
+FileMgr::OnTimerExpired(Timer& timer) {
+	if(__reads.GetCount() == 0) {
+		return;
+	}
+	// Concurrent reads take turns, one chunk each
+	FileRead* pRead = null;
+	__reads.GetAt(0, pRead);
+	__reads.RemoveAt(0);
+	if(SendChunk(*pRead)) {
+		delete pRead;
+	} else {
+		__reads.Add(pRead);
+	}
+	// The chunk is evaluated before the next one is read
+	pResults->Flush();
+	if(__reads.GetCount() > 0 && !__suspended) {
+		__chunkTimer.Start(CHUNK_INTERVAL);
+	}
+}
+
+void
+FileMgr::Write(const String& callbackId, const String& fileName, const String& data, long long position) {
+	String path = GetPath(fileName);
+	File file;
+	result r = file.Construct(path, File::IsFileExist(path) ? L"r+" : L"w+");
+	if(!IsFailed(r)) {
+		r = file.Seek(FILESEEKPOSITION_BEGIN, (long)position);
+	}
+	if(IsFailed(r)) {
+		AppLogException("Could not open %S for writing", path.GetPointer());
+		Fail(callbackId, GetErrorCode(r, FILE_ERROR_NO_MODIFICATION_ALLOWED));
+		return;
+	}
+
+	const mchar* pChars = data.GetPointer();
+	int length = data.GetLength();
+	long long written = 0;
+	String slice(WRITE_SLICE);
+	for(int start = 0 ; start < length ; ) {
+		int count = length - start < WRITE_SLICE ? length - start : WRITE_SLICE;
+		// A surrogate pair is converted in one piece
+		if(start + count < length && pChars[start + count - 1] >= 0xD800 && pChars[start + count - 1] <= 0xDBFF) {
+			count--;
+		}
+		data.SubString(start, count, slice);
+		ByteBuffer* pBytes = __utf8.GetBytesN(slice);
+		if(pBytes == null) {
+			Fail(callbackId, FILE_ERROR_ENCODING);
+			return;
+		}
+		// The converted bytes end with a null terminator
+		int size = pBytes->GetLimit();
+		if(size > 0 && pBytes->GetPointer()[size - 1] == 0) {
+			size--;
+		}
+		r = file.Write(pBytes->GetPointer(), size);
+		delete pBytes;
+		if(IsFailed(r)) {
+			AppLogException("Could not write %S", path.GetPointer());
+			Fail(callbackId, GetErrorCode(r, FILE_ERROR_NO_MODIFICATION_ALLOWED));
+			return;
+		}
+		written += size;
+		start += count;
+	}
+	file.Flush();
+	Succeed(callbackId, written);
+}
+
+void
+FileMgr::Truncate(const String& callbackId, const String& fileName, long long size) {
+	String path = GetPath(fileName);
+	File file;
+	result r = file.Construct(path, L"r+");
+	if(!IsFailed(r)) {
+		r = file.Truncate((int)size);
+	}
+	FileAttributes attributes;
+	if(!IsFailed(r)) {
+		r = File::GetAttributes(path, attributes);
+	}
+	if(IsFailed(r)) {
+		AppLogException("Could not truncate %S", path.GetPointer());
+		Fail(callbackId, GetErrorCode(r, FILE_ERROR_NO_MODIFICATION_ALLOWED));
+		return;
+	}
+	Succeed(callbackId, attributes.GetFileSize());
+}
@@ -5,7 +5,45 @@
  *      Author: Anis Kadri
  */
 
+#include <math.h>
+#include <FSystem.h>
 #include "GeoLocation.h"
+#include "CommandRegistry.h"
+
+using namespace Osp::System;
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Geolocation", GeoLocation)
+
+// Below this speed (m/s) the device is considered stationary
+static const float STATIONARY_SPEED = 1.0f;
+// Distance (m) the device should travel between two fixes while moving
+static const float TARGET_DISTANCE = 50.0f;
+
+PositionRequest::PositionRequest(const String& callbackId, long long deadline, bool highAccuracy)
+	: callbackId(callbackId), deadline(deadline), highAccuracy(highAccuracy) {
+}
+
+PositionRequest::~PositionRequest() {
+}
+
+PositionWatch::PositionWatch(const String& callbackId, int timeout, bool highAccuracy, int minimumInterval, float distanceFilter)
+	: callbackId(callbackId), timeout(timeout), highAccuracy(highAccuracy), minimumInterval(minimumInterval), distanceFilter(distanceFilter), deadline(0) {
+	sent.valid = false;
+}
+
+PositionWatch::~PositionWatch() {
+}
+
+bool
+PositionWatch::Accepts(const PositionFix& fix) const {
+	if(!sent.valid) {
+		return true;
+	}
+	if(fix.receivedAt - sent.receivedAt < minimumInterval) {
+		return false;
+	}
+	return distanceFilter <= 0.0f || GeoLocation::GetDistance(sent, fix) >= distanceFilter;
+}
 
 GeoLocation::GeoLocation() {
 	// TODO Auto-generated constructor stub
@@ -13,115 +51,494 @@ GeoLocation::GeoLocation() {
 }
 
 GeoLocation::GeoLocation(Web* pWeb): PhoneGapCommand(pWeb) {
-	locProvider = new LocationProvider();
-	locProvider->Construct(LOC_METHOD_HYBRID);
-	watching = false;
+	// Constructed with the method needed by the first watch or request
+	locProvider = null;
+	__fix.valid = false;
+	__watches.Construct();
+	__requests.Construct();
+	__timeoutTimer.Construct(*this);
+	__highAccuracy = false;
+	__interval = 0;
+	__adaptiveInterval = DEFAULT_INTERVAL;
+	__suspended = false;
 }
 
 GeoLocation::~GeoLocation() {
+	__timeoutTimer.Cancel();
+	for(int i = 0 ; i < __requests.GetCount() ; i++) {
+		PositionRequest* pRequest = null;
+		__requests.GetAt(i, pRequest);
+		delete pRequest;
+	}
+	__requests.RemoveAll();
+	IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		PositionWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			delete pWatch;
+		}
+		delete pWatches;
+	}
+	__watches.RemoveAll();
+	if(locProvider && __interval > 0) {
+		locProvider->CancelLocationUpdates();
+	}
 	delete locProvider;
 }
 
+long long
+GeoLocation::GetTicks(void) {
+	long long ticks = 0;
+	SystemTime::GetTicks(ticks);
+	return ticks;
+}
+
 void
-GeoLocation::Run(const String& command) {
-	if(!command.IsEmpty()) {
-		Uri commandUri;
-		commandUri.SetUri(command);
-		String method = commandUri.GetHost();
-		StringTokenizer strTok(commandUri.GetPath(), L"/");
-		if(strTok.GetTokenCount() > 1) {
-			strTok.GetNextToken(callbackId);
-			AppLogDebug("Method %S, CallbackId: %S", method.GetPointer(), callbackId.GetPointer());
-		}
-		AppLogDebug("Method %S, Callback: %S", method.GetPointer(), callbackId.GetPointer());
-		// used to determine callback ID
-		if(method == L"com.phonegap.Geolocation.watchPosition" && !callbackId.IsEmpty() && !IsWatching()) {
-			AppLogDebug("watching position...");
-			StartWatching();
+GeoLocation::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	AppLogDebug("Method %S, Callback: %S", method.GetPointer(), args.GetCallbackId().GetPointer());
+	// [maximumAge, timeout, enableHighAccuracy]
+	int maximumAge = 0;
+	int timeout = 0;
+	if(args.GetInt(0, maximumAge) != E_SUCCESS || maximumAge < 0) {
+		maximumAge = 0;
+	}
+	if(args.GetInt(1, timeout) != E_SUCCESS || timeout < 0) {
+		timeout = 0;
+	}
+	bool highAccuracy = args.GetBool(2, false);
+	if(method == L"watchPosition" && args.HasCallback()) {
+		AppLogDebug("watching position...");
+		int minimumInterval = 0;
+		double distanceFilter = 0.0;
+		if(Integer::Parse(args.GetOption(L"minimumInterval"), minimumInterval) != E_SUCCESS || minimumInterval < 0) {
+			minimumInterval = 0;
 		}
-		if(method == L"com.phonegap.Geolocation.stop" && IsWatching()) {
-			AppLogDebug("stop watching position...");
-			StopWatching();
+		if(Double::Parse(args.GetOption(L"distanceFilter"), distanceFilter) != E_SUCCESS || distanceFilter < 0.0) {
+			distanceFilter = 0.0;
 		}
-		if(method == L"com.phonegap.Geolocation.getCurrentPosition" && !callbackId.IsEmpty() && !IsWatching()) {
-			AppLogDebug("getting current position...");
-			GetLastKnownLocation();
+		// Pages that do not name their watch get it named after its callback
+		const String& watchId = args.HasOption(L"id") ? args.GetOption(L"id") : args.GetCallbackId();
+		PositionWatch* pWatch = new PositionWatch(args.GetCallbackId(), timeout, highAccuracy, minimumInterval, (float)distanceFilter);
+		StartWatching(watchId, pWatch);
+		if(IsFresh(maximumAge)) {
+			SendPosition(pWatch->callbackId, __fix);
+			pWatch->sent = __fix;
 		}
-		AppLogDebug("GeoLocation command %S completed", command.GetPointer());
 	}
+	if(method == L"stop" && IsWatching()) {
+		AppLogDebug("stop watching position...");
+		StopWatching(args.GetString(0));
+	}
+	if(method == L"getCurrentPosition" && args.HasCallback()) {
+		AppLogDebug("getting current position...");
+		GetCurrentPosition(args.GetCallbackId(), maximumAge, timeout, highAccuracy);
+	}
+	AppLogDebug("GeoLocation command %S completed", method.GetPointer());
 }
 
 void
-GeoLocation::StartWatching() {
-	locProvider->RequestLocationUpdates(*this, 5, false);
-	watching = true;
-	AppLogDebug("Start Watching Location");
+GeoLocation::StartWatching(const String& watchId, PositionWatch* pWatch) {
+	StopWatching(watchId);
+	pWatch->deadline = pWatch->timeout > 0 ? GetTicks() + pWatch->timeout : 0;
+	__watches.Add(watchId, pWatch);
+	if(__watches.GetCount() == 1) {
+		__adaptiveInterval = DEFAULT_INTERVAL;
+	}
+	UpdateProvider();
+	ScheduleTimeout();
+	AppLogDebug("Start Watching Location, %d watches", __watches.GetCount());
 }
 
 void
-GeoLocation::StopWatching() {
-	locProvider->CancelLocationUpdates();
-	watching = false;
-	AppLogDebug("Stop Watching Location");
+GeoLocation::StopWatching(const String& watchId) {
+	PositionWatch* pWatch = null;
+	if(watchId.IsEmpty() && __watches.GetCount() == 1) {
+		// Older pages clear their only watch without naming it
+		IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+		String onlyId;
+		if(pWatches && pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetKey(onlyId);
+		}
+		delete pWatches;
+		StopWatching(onlyId);
+		return;
+	}
+	if(__watches.GetValue(watchId, pWatch) != E_SUCCESS || pWatch == null) {
+		return;
+	}
+	__watches.Remove(watchId);
+	delete pWatch;
+	UpdateProvider();
+	ScheduleTimeout();
+	AppLogDebug("Stop Watching Location, %d watches", __watches.GetCount());
 }
 
 bool
 GeoLocation::IsWatching() {
-	return watching;
+	return __watches.GetCount() > 0;
+}
+
+bool
+GeoLocation::IsFresh(int maximumAge) const {
+	return __fix.valid && maximumAge > 0 && GetTicks() - __fix.receivedAt <= maximumAge;
+}
+
+void
+GeoLocation::GetCurrentPosition(const String& callbackId, int maximumAge, int timeout, bool highAccuracy) {
+	// Cached fix young enough for the page, the provider is not involved
+	if(IsFresh(maximumAge)) {
+		SendPosition(callbackId, __fix);
+		return;
+	}
+	if(timeout == 0) {
+		SendError(callbackId, POSITION_ERROR_TIMEOUT, L"Timeout");
+		return;
+	}
+	__requests.Add(new PositionRequest(callbackId, GetTicks() + timeout, highAccuracy));
+	UpdateProvider();
+	ScheduleTimeout();
 }
 
 void
-GeoLocation::GetLastKnownLocation() {
-	Location *location = locProvider->GetLastKnownLocationN();
-	if(location->GetQualifiedCoordinates() != null) {
-		const QualifiedCoordinates *q = location->GetQualifiedCoordinates();
-		double latitude = q->GetLatitude();
-		double longitude = q->GetLongitude();
-		float altitude = q->GetAltitude();
-		float accuracy = q->GetHorizontalAccuracy();
-		float heading = q->GetVerticalAccuracy();
-		float speed = location->GetSpeed();
-		long long timestamp = location->GetTimestamp();
-		AppLogDebug("new Coordinates(%d,%d,%f,%f,%f,%f)", latitude, longitude, altitude, speed, accuracy, heading);
-		String coordinates;
-		coordinates.Format(256, L"new Coordinates(%d,%d,%f,%f,%f,%f)", latitude, longitude, altitude, speed, accuracy, heading);
-		String res;
-		res.Format(512, L"PhoneGap.callbacks['%S'].success(new Position(%S,%d))", callbackId.GetPointer(), coordinates.GetPointer(), timestamp);
-		pWeb->EvaluateJavascriptN(res);
+GeoLocation::UpdateProvider(void) {
+	bool highAccuracy = false;
+	for(int i = 0 ; i < __requests.GetCount() ; i++) {
+		PositionRequest* pRequest = null;
+		__requests.GetAt(i, pRequest);
+		highAccuracy = highAccuracy || pRequest->highAccuracy;
+	}
+	// Smallest minimumInterval and timeout of the watches, in seconds
+	int floor = 0;
+	int ceiling = 0;
+	IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		PositionWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			highAccuracy = highAccuracy || pWatch->highAccuracy;
+			int minimum = pWatch->minimumInterval / 1000;
+			if(floor == 0 || minimum < floor) {
+				floor = minimum;
+			}
+			int half = pWatch->timeout / 2000;
+			if(pWatch->timeout > 0 && (ceiling == 0 || half < ceiling)) {
+				ceiling = half;
+			}
+		}
+		delete pWatches;
+	}
+
+	int interval = 0;
+	if(__suspended) {
+		// Stopped until Resume()
+	} else if(__requests.GetCount() > 0) {
+		// Someone is waiting for a fix
+		interval = MIN_INTERVAL;
+	} else if(IsWatching()) {
+		// No faster than any watch accepts fixes, often enough for every watch to hear from us within its timeout
+		interval = __adaptiveInterval > floor ? __adaptiveInterval : floor;
+		if(ceiling > 0 && interval > ceiling) {
+			interval = ceiling;
+		}
+		// Saving the battery wins over the timeouts, watches are told when they expire
+		interval = QosPolicy::CapLocationInterval(interval);
+		if(interval < MIN_INTERVAL) {
+			interval = MIN_INTERVAL;
+		}
+	}
+
+	if(interval == 0) {
+		if(locProvider && __interval > 0) {
+			locProvider->CancelLocationUpdates();
+			AppLogDebug("Location updates stopped");
+		}
+		__interval = 0;
+		return;
+	}
+	// The method is chosen at construction, the provider is replaced to use GPS, or to go
+	// back to the hybrid method when it is restarted. Never from its own callback: a fix
+	// only ever lowers the accuracy needed.
+	if(locProvider && ((highAccuracy && !__highAccuracy) || (__interval == 0 && highAccuracy != __highAccuracy))) {
+		if(__interval > 0) {
+			locProvider->CancelLocationUpdates();
+		}
+		delete locProvider;
+		locProvider = null;
+		__interval = 0;
+	}
+	if(locProvider == null) {
+		locProvider = new LocationProvider();
+		result r = locProvider->Construct(highAccuracy ? LOC_METHOD_GPS : LOC_METHOD_HYBRID);
+		if(IsFailed(r)) {
+			AppLogException("Could not construct location provider");
+			delete locProvider;
+			locProvider = null;
+			return;
+		}
+		__highAccuracy = highAccuracy;
+	}
+	if(interval == __interval) {
+		return;
+	}
+	if(__interval > 0) {
+		locProvider->CancelLocationUpdates();
+	}
+	result r = locProvider->RequestLocationUpdates(*this, interval, !highAccuracy);
+	if(IsFailed(r)) {
+		AppLogException("Could not request location updates");
+		__interval = 0;
+		return;
+	}
+	__interval = interval;
+	AppLogDebug("Location updates every %d s", interval);
+}
+
+float
+GeoLocation::GetDistance(const PositionFix& from, const PositionFix& to) {
+	// Haversine, in meters
+	const double radius = 6371000.0;
+	const double toRadians = 3.14159265358979323846 / 180.0;
+	double dLatitude = (to.latitude - from.latitude) * toRadians;
+	double dLongitude = (to.longitude - from.longitude) * toRadians;
+	double a = sin(dLatitude / 2) * sin(dLatitude / 2)
+			+ cos(from.latitude * toRadians) * cos(to.latitude * toRadians) * sin(dLongitude / 2) * sin(dLongitude / 2);
+	return (float)(2.0 * radius * atan2(sqrt(a), sqrt(1.0 - a)));
+}
+
+void
+GeoLocation::Adapt(const PositionFix& fix) {
+	int interval = __adaptiveInterval;
+	float speed = fix.speed / 3.6f;
+	if(speed != speed || speed < STATIONARY_SPEED) {
+		// Stationary, backing off
+		interval = __adaptiveInterval * 2;
 	} else {
-		AppLogDebug("PhoneGap.callbacks['%S'].fail(new PositionError(0001,'Could not get location'))", callbackId.GetPointer());
-		String res;
-		res.Format(256, L"PhoneGap.callbacks['%S'].fail(new PositionError(0001,'Could not get location'))", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(res);
+		// One fix per TARGET_DISTANCE, or per accuracy radius when it is coarser
+		float distance = fix.accuracy > TARGET_DISTANCE ? fix.accuracy : TARGET_DISTANCE;
+		interval = (int)(distance / speed);
+	}
+	if(interval < MIN_INTERVAL) {
+		interval = MIN_INTERVAL;
+	} else if(interval > MAX_INTERVAL) {
+		interval = MAX_INTERVAL;
+	}
+	// Small changes are not worth restarting the provider
+	int delta = interval > __adaptiveInterval ? interval - __adaptiveInterval : __adaptiveInterval - interval;
+	if(delta * 4 > __adaptiveInterval) {
+		__adaptiveInterval = interval;
+	}
+}
+
+void
+GeoLocation::ScheduleTimeout(void) {
+	__timeoutTimer.Cancel();
+	if(__suspended) {
+		return;
+	}
+	long long deadline = 0;
+	IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		PositionWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			if(pWatch->deadline > 0 && (deadline == 0 || pWatch->deadline < deadline)) {
+				deadline = pWatch->deadline;
+			}
+		}
+		delete pWatches;
+	}
+	for(int i = 0 ; i < __requests.GetCount() ; i++) {
+		PositionRequest* pRequest = null;
+		__requests.GetAt(i, pRequest);
+		if(deadline == 0 || pRequest->deadline < deadline) {
+			deadline = pRequest->deadline;
+		}
+	}
+	if(deadline == 0) {
+		return;
 	}
+	long long delay = deadline - GetTicks();
+	__timeoutTimer.Start(delay > 0 ? (int)delay : 1);
+}
+
+void
+GeoLocation::Suspend(void) {
+	if(__suspended) {
+		return;
+	}
+	__suspended = true;
+	UpdateProvider();
+	ScheduleTimeout();
+	AppLogDebug("Location suspended, %d watches kept", __watches.GetCount());
+}
+
+void
+GeoLocation::Resume(void) {
+	if(!__suspended) {
+		return;
+	}
+	__suspended = false;
+	// Watches did not time out while no fix could be asked for, they start over.
+	// Requests keep their deadline, the page waited that long
+	long long now = GetTicks();
+	IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		PositionWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			if(pWatch->timeout > 0) {
+				pWatch->deadline = now + pWatch->timeout;
+			}
+		}
+		delete pWatches;
+	}
+	UpdateProvider();
+	ScheduleTimeout();
+}
+
+long
+GeoLocation::ReleaseMemory(void) {
+	// The last fix is kept, it is small and answers maximumAge requests without the provider
+	if(locProvider == null || __interval > 0) {
+		return 0;
+	}
+	// Idle provider, constructed again by the next watch or request
+	// Its size is not known, nothing is reported
+	delete locProvider;
+	locProvider = null;
+	return 0;
+}
+
+void
+GeoLocation::ApplyQos(void) {
+	UpdateProvider();
+}
+
+void
+GeoLocation::OnTimerExpired(Timer& timer) {
+	long long now = GetTicks();
+	for(int i = __requests.GetCount() - 1 ; i >= 0 ; i--) {
+		PositionRequest* pRequest = null;
+		__requests.GetAt(i, pRequest);
+		if(pRequest->deadline <= now) {
+			SendError(pRequest->callbackId, POSITION_ERROR_TIMEOUT, L"Timeout");
+			__requests.RemoveAt(i);
+			delete pRequest;
+		}
+	}
+	IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		PositionWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			if(pWatch->deadline > 0 && pWatch->deadline <= now) {
+				SendError(pWatch->callbackId, POSITION_ERROR_TIMEOUT, L"Timeout");
+				pWatch->deadline = now + pWatch->timeout;
+			}
+		}
+		delete pWatches;
+	}
+	UpdateProvider();
+	ScheduleTimeout();
 }
 
 void
 GeoLocation::OnLocationUpdated(Location& location) {
-	if(location.GetQualifiedCoordinates() != null) {
-		const QualifiedCoordinates *q = location.GetQualifiedCoordinates();
-		double latitude = q->GetLatitude();
-		double longitude = q->GetLongitude();
-		float altitude = q->GetAltitude();
-		float accuracy = q->GetHorizontalAccuracy();
-		float heading = q->GetVerticalAccuracy();
-		float speed = location.GetSpeed();
-		long long timestamp = location.GetTimestamp();
-		AppLogDebug("new Coordinates(%d,%d,%f,%f,%f,%f)", latitude, longitude, altitude, speed, accuracy, heading);
-		String coordinates;
-		coordinates.Format(256, L"new Coordinates(%d,%d,%f,%f,%f,%f)", latitude, longitude, altitude, speed, accuracy, heading);
-		String res;
-		res.Format(512, L"PhoneGap.callbacks['%S'].success(new Position(%S,%d))", callbackId.GetPointer(), coordinates.GetPointer(), timestamp);
-		pWeb->EvaluateJavascriptN(res);
-	} else {
-		AppLogDebug("PhoneGap.callbacks['%S'].fail(new PositionError(0001,'Could not get location'))", callbackId.GetPointer());
-		String res;
-		res.Format(256, L"PhoneGap.callbacks['%S'].fail(new PositionError(0001,'Could not get location'))", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(res);
+	const QualifiedCoordinates *q = location.GetQualifiedCoordinates();
+	if(q == null) {
+		AppLogDebug("Location update without coordinates");
+		return;
 	}
+	__fix.latitude = q->GetLatitude();
+	__fix.longitude = q->GetLongitude();
+	__fix.altitude = q->GetAltitude();
+	__fix.accuracy = q->GetHorizontalAccuracy();
+	__fix.altitudeAccuracy = q->GetVerticalAccuracy();
+	__fix.course = location.GetCourse();
+	__fix.speed = location.GetSpeed();
+	__fix.timestamp = location.GetTimestamp();
+	__fix.receivedAt = GetTicks();
+	__fix.valid = true;
+
+	for(int i = 0 ; i < __requests.GetCount() ; i++) {
+		PositionRequest* pRequest = null;
+		__requests.GetAt(i, pRequest);
+		SendPosition(pRequest->callbackId, __fix);
+		delete pRequest;
+	}
+	__requests.RemoveAll();
+	// One subscription, fanned out to the watches that want this fix
+	IMapEnumeratorT<String, PositionWatch*>* pWatches = __watches.GetMapEnumeratorN();
+	if(pWatches) {
+		PositionWatch* pWatch = null;
+		while(pWatches->MoveNext() == E_SUCCESS) {
+			pWatches->GetValue(pWatch);
+			if(pWatch->timeout > 0) {
+				pWatch->deadline = __fix.receivedAt + pWatch->timeout;
+			}
+			if(pWatch->Accepts(__fix)) {
+				SendPosition(pWatch->callbackId, __fix);
+				pWatch->sent = __fix;
+			}
+		}
+		delete pWatches;
+	}
+	if(IsWatching()) {
+		Adapt(__fix);
+	}
+	UpdateProvider();
+	ScheduleTimeout();
 }
 
 void
-GeoLocation::OnProviderStateChanged(LocProviderState newState) {
+GeoLocation::SendPosition(const String& callbackId, const PositionFix& fix) {
+	AppLogDebug("new Coordinates(%f,%f,%f,%f,%f,%f)", fix.latitude, fix.longitude, fix.altitude, fix.speed, fix.accuracy, fix.altitudeAccuracy);
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	// Coordinates(lat, lng, alt, acc, head, vel, altacc), speed in m/s
+	pScript->BeginCallback(callbackId, L"success")
+			.BeginCall(L"new Position")
+				.BeginCall(L"new Coordinates")
+					.AppendDouble(fix.latitude)
+					.AppendDouble(fix.longitude)
+					.AppendFloat(fix.altitude)
+					.AppendFloat(fix.accuracy)
+					.AppendFloat(fix.course)
+					.AppendFloat(fix.speed / 3.6f)
+					.AppendFloat(fix.altitudeAccuracy)
+				.EndCall()
+				.AppendLong(fix.timestamp)
+			.EndCall()
+			.EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
 
+void
+GeoLocation::SendError(const String& callbackId, int code, const mchar* pMessage) {
+	AppLogDebug("Could not get location");
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"fail")
+			.BeginCall(L"new PositionError").AppendInt(code).AppendString(pMessage).EndCall()
+			.EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+void
+GeoLocation::OnProviderStateChanged(LocProviderState newState) {
+	if(newState != LOC_PROVIDER_OUT_OF_SERVICE) {
+		return;
+	}
+	// Nothing to wait for, the pending requests fail now rather than at their timeout
+	for(int i = 0 ; i < __requests.GetCount() ; i++) {
+		PositionRequest* pRequest = null;
+		__requests.GetAt(i, pRequest);
+		SendError(pRequest->callbackId, POSITION_ERROR_UNAVAILABLE, L"Location provider out of service");
+		delete pRequest;
+	}
+	__requests.RemoveAll();
+	UpdateProvider();
+	ScheduleTimeout();
 }
@@ -0,0 +1,245 @@
+/*
+ * JsonReader.cpp
+ *
+ *  Pull reader walking a JSON document one token at a time, without building
+ *  an intermediate tree.
+ */
+
+#include "../inc/JsonReader.h"
+
+static int
+HexDigit(mchar ch) {
+	if(ch >= L'0' && ch <= L'9') {
+		return ch - L'0';
+	}
+	if(ch >= L'a' && ch <= L'f') {
+		return ch - L'a' + 10;
+	}
+	if(ch >= L'A' && ch <= L'F') {
+		return ch - L'A' + 10;
+	}
+	return -1;
+}
+
+JsonReader::JsonReader() : __pChars(null), __length(0), __pos(0), __depth(0), __token(JSON_TOKEN_END) {
+}
+
+JsonReader::~JsonReader() {
+}
+
+result
+JsonReader::Construct(const String& json) {
+	__pChars = json.GetPointer();
+	__length = json.GetLength();
+	__pos = 0;
+	__depth = 0;
+	__token = JSON_TOKEN_END;
+	__value.Clear();
+	return __pChars ? E_SUCCESS : E_INVALID_ARG;
+}
+
+void
+JsonReader::SkipWhitespace(void) {
+	while(__pos < __length) {
+		mchar ch = __pChars[__pos];
+		if(ch != L' ' && ch != L'\t' && ch != L'\r' && ch != L'\n' && ch != L',') {
+			break;
+		}
+		__pos++;
+	}
+}
+
+bool
+JsonReader::ReadString(void) {
+	// __pos is on the opening quote
+	__value.Clear();
+	__pos++;
+	while(__pos < __length) {
+		mchar ch = __pChars[__pos++];
+		if(ch == L'"') {
+			return true;
+		}
+		if(ch != L'\\') {
+			__value.Append(ch);
+			continue;
+		}
+		if(__pos >= __length) {
+			break;
+		}
+		ch = __pChars[__pos++];
+		switch(ch) {
+		case L'b': __value.Append(L'\b'); break;
+		case L'f': __value.Append(L'\f'); break;
+		case L'n': __value.Append(L'\n'); break;
+		case L'r': __value.Append(L'\r'); break;
+		case L't': __value.Append(L'\t'); break;
+		case L'u': {
+			if(__pos + 4 > __length) {
+				return false;
+			}
+			int codeUnit = 0;
+			for(int i = 0 ; i < 4 ; i++) {
+				int digit = HexDigit(__pChars[__pos++]);
+				if(digit < 0) {
+					return false;
+				}
+				codeUnit = (codeUnit << 4) | digit;
+			}
+			// surrogate pairs are kept as two code units, like String stores them
+			__value.Append((mchar)codeUnit);
+			break;
+		}
+		default:
+			// \" \\ \/
+			__value.Append(ch);
+			break;
+		}
+	}
+	AppLogException("Unterminated JSON string");
+	return false;
+}
+
+bool
+JsonReader::ReadLiteral(const mchar* pLiteral) {
+	int start = __pos;
+	for(const mchar* p = pLiteral ; *p ; p++) {
+		if(__pos >= __length || __pChars[__pos] != *p) {
+			__pos = start;
+			return false;
+		}
+		__pos++;
+	}
+	__value.Clear();
+	__value.Append(pLiteral);
+	return true;
+}
+
+void
+JsonReader::ReadNumber(void) {
+	__value.Clear();
+	while(__pos < __length) {
+		mchar ch = __pChars[__pos];
+		if((ch < L'0' || ch > L'9') && ch != L'-' && ch != L'+' && ch != L'.' && ch != L'e' && ch != L'E') {
+			break;
+		}
+		__value.Append(ch);
+		__pos++;
+	}
+}
+
+JsonToken
+JsonReader::Next(void) {
+	if(__token == JSON_TOKEN_ERROR) {
+		return __token;
+	}
+	SkipWhitespace();
+	if(__pos >= __length) {
+		__token = __depth == 0 ? JSON_TOKEN_END : JSON_TOKEN_ERROR;
+		return __token;
+	}
+	mchar ch = __pChars[__pos];
+	switch(ch) {
+	case L'{':
+		__pos++;
+		__depth++;
+		__token = JSON_TOKEN_BEGIN_OBJECT;
+		break;
+	case L'}':
+		__pos++;
+		__depth--;
+		__token = JSON_TOKEN_END_OBJECT;
+		break;
+	case L'[':
+		__pos++;
+		__depth++;
+		__token = JSON_TOKEN_BEGIN_ARRAY;
+		break;
+	case L']':
+		__pos++;
+		__depth--;
+		__token = JSON_TOKEN_END_ARRAY;
+		break;
+	case L'"':
+		if(!ReadString()) {
+			__token = JSON_TOKEN_ERROR;
+			break;
+		}
+		// A string followed by a colon is a member name
+		SkipWhitespace();
+		if(__pos < __length && __pChars[__pos] == L':') {
+			__pos++;
+			__token = JSON_TOKEN_NAME;
+		} else {
+			__token = JSON_TOKEN_STRING;
+		}
+		break;
+	case L't':
+		__token = ReadLiteral(L"true") ? JSON_TOKEN_BOOLEAN : JSON_TOKEN_ERROR;
+		break;
+	case L'f':
+		__token = ReadLiteral(L"false") ? JSON_TOKEN_BOOLEAN : JSON_TOKEN_ERROR;
+		break;
+	case L'n':
+		__token = ReadLiteral(L"null") ? JSON_TOKEN_NULL : JSON_TOKEN_ERROR;
+		break;
+	default:
+		if(ch == L'-' || (ch >= L'0' && ch <= L'9')) {
+			ReadNumber();
+			__token = JSON_TOKEN_NUMBER;
+		} else {
+			__token = JSON_TOKEN_ERROR;
+		}
+		break;
+	}
+	if(__token == JSON_TOKEN_ERROR) {
+		AppLogException("Malformed JSON at offset %d", __pos);
+	}
+	return __token;
+}
+
+JsonToken
+JsonReader::GetToken(void) const {
+	return __token;
+}
+
+const String&
+JsonReader::GetValue(void) const {
+	return __value;
+}
+
+result
+JsonReader::GetInt(int& value) const {
+	if(__token != JSON_TOKEN_NUMBER && __token != JSON_TOKEN_STRING) {
+		return E_INVALID_STATE;
+	}
+	return Integer::Parse(__value, value);
+}
+
+result
+JsonReader::GetDouble(double& value) const {
+	if(__token != JSON_TOKEN_NUMBER && __token != JSON_TOKEN_STRING) {
+		return E_INVALID_STATE;
+	}
+	return Double::Parse(__value, value);
+}
+
+bool
+JsonReader::GetBool(void) const {
+	return __token == JSON_TOKEN_BOOLEAN && __value == L"true";
+}
+
+result
+JsonReader::Skip(void) {
+	// Skips the value whose first token was just read
+	if(__token != JSON_TOKEN_BEGIN_OBJECT && __token != JSON_TOKEN_BEGIN_ARRAY) {
+		return __token == JSON_TOKEN_ERROR ? E_INVALID_FORMAT : E_SUCCESS;
+	}
+	int depth = __depth - 1;
+	while(__depth > depth) {
+		JsonToken token = Next();
+		if(token == JSON_TOKEN_ERROR || token == JSON_TOKEN_END) {
+			return E_INVALID_FORMAT;
+		}
+	}
+	return E_SUCCESS;
+}
@@ -6,28 +6,88 @@
  */
 
 #include "../inc/Kamera.h"
+#include "../inc/CommandRegistry.h"
 
-Kamera::Kamera(Web* pWeb) : PhoneGapCommand(pWeb) {
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Camera", Kamera)
+
+PreviewTask::PreviewTask(Kamera& kamera, const String& callbackId, const String& capturePath, bool saveToPhotoAlbum, int width, int height)
+	: callbackId(callbackId), capturePath(capturePath), saveToPhotoAlbum(saveToPhotoAlbum), width(width), height(height),
+	  stored(E_SUCCESS), r(E_SUCCESS), __kamera(kamera) {
+	previewPath.Append(L"/Home/preview_");
+	previewPath.Append(File::GetFileName(capturePath));
+}
+
+PreviewTask::~PreviewTask() {
+}
+
+void
+PreviewTask::Execute(void) {
+	// A copy across volumes takes as long as the decoding, neither holds the UI thread
+	stored = Kamera::StorePicture(capturePath, saveToPhotoAlbum, path);
+	if(IsFailed(stored)) {
+		return;
+	}
+	ImageFormat format;
+	int pictureWidth = 0;
+	int pictureHeight = 0;
+	r = Image::GetImageInfo(path, format, pictureWidth, pictureHeight);
+	if(IsFailed(r) || pictureWidth <= 0 || pictureHeight <= 0) {
+		return;
+	}
+	// Fits in width x height, keeping the aspect ratio, never enlarged
+	int previewWidth = pictureWidth;
+	int previewHeight = pictureHeight;
+	if(previewWidth > width) {
+		previewHeight = previewHeight * width / previewWidth;
+		previewWidth = width;
+	}
+	if(previewHeight > height) {
+		previewWidth = previewWidth * height / previewHeight;
+		previewHeight = height;
+	}
+
+	Image image;
+	r = image.Construct();
+	if(IsFailed(r)) {
+		return;
+	}
+	// Decoding straight to the reduced size, the full size bitmap is never allocated
+	Bitmap* pBitmap = image.DecodeN(path, BITMAP_PIXEL_FORMAT_RGB565, previewWidth > 0 ? previewWidth : 1, previewHeight > 0 ? previewHeight : 1);
+	if(pBitmap == null) {
+		r = GetLastResult();
+		return;
+	}
+	r = image.EncodeToFile(*pBitmap, IMG_FORMAT_JPG, previewPath, true);
+	delete pBitmap;
+}
+
+void
+PreviewTask::Complete(void) {
+	__kamera.OnPreviewCompleted(*this);
+}
+
+Kamera::Kamera(Web* pWeb) : PhoneGapCommand(pWeb), __targetWidth(DEFAULT_PREVIEW_SIZE), __targetHeight(DEFAULT_PREVIEW_SIZE), __saveToPhotoAlbum(false) {
 }
 
 Kamera::~Kamera() {
 }
 
 void
-Kamera::Run(const String& command) {
-	if(!command.IsEmpty()) {
-		Uri commandUri;
-		commandUri.SetUri(command);
-		String method = commandUri.GetHost();
-		StringTokenizer strTok(commandUri.GetPath(), L"/");
-		if(strTok.GetTokenCount() < 1) {
-			AppLogException("Not enough params");
-			return;
+Kamera::Run(const CommandArgs& args) {
+	if(!args.HasCallback()) {
+		AppLogException("Not enough params");
+		return;
+	}
+	callbackId = args.GetCallbackId();
+	if(args.GetMethod() == L"getPicture") {
+		if(Integer::Parse(args.GetOption(L"targetWidth"), __targetWidth) != E_SUCCESS || __targetWidth <= 0) {
+			__targetWidth = DEFAULT_PREVIEW_SIZE;
 		}
-		strTok.GetNextToken(callbackId);
-		if(method == "com.phonegap.Camera.getPicture" && !callbackId.IsEmpty()) {
-			GetPicture();
+		if(Integer::Parse(args.GetOption(L"targetHeight"), __targetHeight) != E_SUCCESS || __targetHeight <= 0) {
+			__targetHeight = DEFAULT_PREVIEW_SIZE;
 		}
+		__saveToPhotoAlbum = args.GetOption(L"saveToPhotoAlbum") == L"true";
+		GetPicture();
 	}
 }
 
@@ -61,44 +121,93 @@ Kamera::OnAppControlCompleted (const String &appControlId, const String &operati
 	if (appControlId.Equals(APPCONTROL_CAMERA) && operationId.Equals(OPERATION_CAPTURE))
 	{
 	  pCaptureResult = (Osp::Base::String*)pResultList->GetAt(0);
+	  ScriptBuilder* pScript = ScriptBuilder::Acquire();
 	  if (pCaptureResult->Equals(String(APPCONTROL_RESULT_SUCCEEDED)))
 	  {
-		String eval;
 		AppLog("Camera capture success.");
 		String* pCapturePath = (String*)pResultList->GetAt(1);
 
-		// copying to app Home Folder
-		String homeFilename;
-		homeFilename.Format(128, L"/Home/%S", File::GetFileName(*pCapturePath).GetPointer());
-		result r = File::Copy(*pCapturePath, homeFilename, true);
-
-		if(IsFailed(r)) {
-			AppLogException("Could not copy picture");
-			eval.Format(512, L"PhoneGap.callbacks['%S'].fail('Could not copy picture')", callbackId.GetPointer());
-			AppLogDebug("%S", eval.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+		// Stored and previewed on the worker, the page is answered once both are done
+		// Smaller previews while saving the battery, decoding is the costly part
+		PreviewTask* pTask = new PreviewTask(*this, callbackId, *pCapturePath, __saveToPhotoAlbum,
+				QosPolicy::CapPreviewSize(__targetWidth), QosPolicy::CapPreviewSize(__targetHeight));
+		if(pWorker == null || IsFailed(pWorker->Post(pTask, lane))) {
+			pTask->Execute();
+			pTask->Complete();
+			delete pTask;
 		}
-
-//		Uri imageUri;
-//		imageUri.setUri(homeFilename);
-		eval.Clear();
-		eval.Format(512, L"PhoneGap.callbacks['%S'].success('file://%S')", callbackId.GetPointer(), homeFilename.GetPointer());
-		AppLogDebug("%S", eval.GetPointer());
-		pWeb->EvaluateJavascriptN(eval);
 	  }
 	  else if (pCaptureResult->Equals(String(APPCONTROL_RESULT_CANCELED)))
 	  {
 		AppLog("Camera capture canceled.");
-		String eval;
-		eval.Format(512, L"PhoneGap.callbacks['%S'].fail('Camera capture canceled')", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(eval);
+		pScript->BeginCallback(callbackId, L"fail").AppendString(L"Camera capture canceled").EndCallback();
 	  }
 	  else if (pCaptureResult->Equals(String(APPCONTROL_RESULT_FAILED)))
 	  {
 		AppLog("Camera capture failed.");
-		String eval;
-		eval.Format(512, L"PhoneGap.callbacks['%S'].fail('Camera capture failed')", callbackId.GetPointer());
-		pWeb->EvaluateJavascriptN(eval);
+		pScript->BeginCallback(callbackId, L"fail").AppendString(L"Camera capture failed").EndCallback();
 	  }
+	  AppLogDebug("%S", pScript->GetString().GetPointer());
+	  pResults->Enqueue(pScript->GetString());
+	  ScriptBuilder::Release(pScript);
+	}
+}
+
+bool
+Kamera::IsSameVolume(const String& path1, const String& path2) {
+	// Everything but the memory card is on the internal volume
+	return path1.StartsWith(L"/Storagecard/", 0) == path2.StartsWith(L"/Storagecard/", 0);
+}
+
+result
+Kamera::StorePicture(const String& capturePath, bool saveToPhotoAlbum, String& path) {
+	if(saveToPhotoAlbum) {
+		// Left in the photo album, the page gets the original
+		path = capturePath;
+		return E_SUCCESS;
+	}
+	path = L"/Home/";
+	path.Append(File::GetFileName(capturePath));
+	if(IsSameVolume(capturePath, path)) {
+		// Renaming is enough, no byte of the picture is copied
+		if(!IsFailed(File::Move(capturePath, path))) {
+			return E_SUCCESS;
+		}
+		AppLogDebug("Could not move %S, copying", capturePath.GetPointer());
+	}
+	return File::Copy(capturePath, path, true);
+}
+
+void
+Kamera::SendPicture(const String& callbackId, const String& path, const String& previewPath) {
+	String uri(L"file://");
+	uri.Append(path);
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success").AppendString(uri);
+	if(previewPath.IsEmpty()) {
+		pScript->AppendNull();
+	} else {
+		String previewUri(L"file://");
+		previewUri.Append(previewPath);
+		pScript->AppendString(previewUri);
+	}
+	pScript->EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+void
+Kamera::OnPreviewCompleted(PreviewTask& task) {
+	if(IsFailed(task.stored)) {
+		AppLogException("Could not store picture");
+		ScriptBuilder* pScript = ScriptBuilder::Acquire();
+		pScript->BeginCallback(task.callbackId, L"fail").AppendString(L"Could not store picture").EndCallback();
+		pResults->Enqueue(pScript->GetString());
+		ScriptBuilder::Release(pScript);
+	} else if(IsFailed(task.r)) {
+		AppLogException("Could not make a preview of %S", task.path.GetPointer());
+		SendPicture(task.callbackId, task.path, L"");
+	} else {
+		SendPicture(task.callbackId, task.path, task.previewPath);
 	}
 }
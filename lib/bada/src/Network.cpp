@@ -6,101 +6,322 @@
  */
 
 #include "../inc/Network.h"
+#include "../inc/CommandRegistry.h"
 
-Network::Network(Web* pWeb) : PhoneGapCommand(pWeb) {
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Network", Network)
+
+HostProbe::HostProbe(const String& host)
+	: host(host), pSession(null), pTransaction(null), valid(false), error(E_SUCCESS), status(0), httpCode(0), checkedAt(0) {
+	callbacks.Construct();
+}
+
+HostProbe::~HostProbe() {
+	// Deleting the session closes its transactions
+	delete pSession;
+}
+
+bool
+HostProbe::IsFresh(long long now, int maximumAge) const {
+	if(!valid) {
+		return false;
+	}
+	int ttl = error == E_SUCCESS ? Network::REACHABLE_TTL : Network::UNREACHABLE_TTL;
+	if(maximumAge >= 0 && maximumAge < ttl) {
+		ttl = maximumAge;
+	}
+	return now - checkedAt <= ttl;
+}
+
+Network::Network(Web* pWeb) : PhoneGapCommand(pWeb), __watchingConnection(false) {
+	__probes.Construct(MAX_HOSTS);
+	__monitor.Construct(*this);
 }
 
 Network::~Network() {
-	delete __pHttpSession;
+	IMapEnumeratorT<String, HostProbe*>* pProbes = __probes.GetMapEnumeratorN();
+	if(pProbes) {
+		HostProbe* pProbe = null;
+		while(pProbes->MoveNext() == E_SUCCESS) {
+			pProbes->GetValue(pProbe);
+			delete pProbe;
+		}
+		delete pProbes;
+	}
+	__probes.RemoveAll();
+}
+
+long long
+Network::GetTicks(void) {
+	long long ticks = 0;
+	SystemTime::GetTicks(ticks);
+	return ticks;
 }
 
 void
-Network::Run(const String& command) {
-	if (!command.IsEmpty()) {
-		String args;
-		String delim(L"/");
-		command.SubString(String(L"gap://").GetLength(), args);
-		StringTokenizer strTok(args, delim);
-		if(strTok.GetTokenCount() < 3) {
-			AppLogDebug("Not enough params");
-			return;
+Network::Run(const CommandArgs& args) {
+	if(args.GetMethod() == L"watchConnection") {
+		// Current type first, then only its changes
+		__watchingConnection = true;
+		SendConnection(__monitor.GetType());
+		return;
+	}
+	if(!args.HasCallback() || args.GetCount() < 1) {
+		AppLogDebug("Not enough params");
+		return;
+	}
+	// hostAddr is already URL decoded
+	const String& hostAddr = args.GetString(0);
+	AppLogDebug("Method %S, callbackId %S, hostAddr %S", args.GetMethod().GetPointer(), args.GetCallbackId().GetPointer(), hostAddr.GetPointer());
+	if(args.GetMethod() == L"isReachable") {
+		// [uri, isIpAddress, {maximumAge}]
+		int maximumAge = -1;
+		if(Integer::Parse(args.GetOption(L"maximumAge"), maximumAge) != E_SUCCESS) {
+			maximumAge = -1;
 		}
-		String method;
-		String hostAddr;
-		strTok.GetNextToken(method);
-		strTok.GetNextToken(callbackId);
-		strTok.GetNextToken(hostAddr);
-
-		// URL decoding
-		Uri uri;
-		uri.SetUri(hostAddr);
-		AppLogDebug("Method %S, callbackId %S, hostAddr %S URI %S", method.GetPointer(), callbackId.GetPointer(), hostAddr.GetPointer(), uri.ToString().GetPointer());
-		if(method == L"com.phonegap.Network.isReachable") {
-			IsReachable(uri.ToString());
+		IsReachable(hostAddr, args.GetCallbackId(), maximumAge);
+	}
+	AppLogDebug("Network command %S completed", args.GetMethod().GetPointer());
+}
+
+void
+Network::IsReachable(const String& hostAddr, const String& callbackId, int maximumAge) {
+	String uri(hostAddr);
+	int index = -1;
+	if(uri.IndexOf(L"://", 0, index) != E_SUCCESS) {
+		uri.Insert(L"http://", 0);
+		uri.IndexOf(L"://", 0, index);
+	}
+	// scheme://host[:port], the pool and the cache are per host
+	String host;
+	int end = -1;
+	if(uri.IndexOf(L'/', index + 3, end) != E_SUCCESS) {
+		end = uri.GetLength();
+	}
+	uri.SubString(0, end, host);
+
+	HostProbe* pProbe = GetProbe(host);
+	if(pProbe->IsFresh(GetTicks(), maximumAge)) {
+		AppLogDebug("Reachability of %S from cache", host.GetPointer());
+		SendStatus(callbackId, pProbe);
+		return;
+	}
+	pProbe->callbacks.Add(callbackId);
+	if(pProbe->pTransaction) {
+		AppLogDebug("Waiting for the probe of %S", host.GetPointer());
+		return;
+	}
+	result r = Submit(pProbe, uri);
+	if(IsFailed(r)) {
+		Finish(pProbe, r, 0);
+	}
+}
+
+long
+Network::ReleaseMemory(void) {
+	// Idle hosts and their sessions, the next check of a host starts a new session
+	ArrayListT<HostProbe*> idle;
+	idle.Construct(MAX_HOSTS);
+	IMapEnumeratorT<String, HostProbe*>* pProbes = __probes.GetMapEnumeratorN();
+	if(pProbes) {
+		HostProbe* pProbe = null;
+		while(pProbes->MoveNext() == E_SUCCESS) {
+			pProbes->GetValue(pProbe);
+			if(pProbe->pTransaction == null) {
+				idle.Add(pProbe);
+			}
+		}
+		delete pProbes;
+	}
+	long freed = 0;
+	for(int i = 0 ; i < idle.GetCount() ; i++) {
+		HostProbe* pProbe = null;
+		idle.GetAt(i, pProbe);
+		freed += sizeof(HostProbe) + pProbe->host.GetLength() * sizeof(mchar);
+		if(pProbe->pSession) {
+			freed += sizeof(HttpSession);
 		}
-		AppLogDebug("Network command %S completed", command.GetPointer());
-		} else {
-			AppLogDebug("Can't run empty command");
+		__probes.Remove(pProbe->host);
+		delete pProbe;
+	}
+	AppLogDebug("%d idle hosts released", idle.GetCount());
+	return freed;
+}
+
+HostProbe*
+Network::GetProbe(const String& host) {
+	HostProbe* pProbe = null;
+	if(__probes.GetValue(host, pProbe) == E_SUCCESS && pProbe) {
+		return pProbe;
+	}
+	if(__probes.GetCount() >= MAX_HOSTS) {
+		// Drops the idle host checked the longest ago
+		HostProbe* pOldest = null;
+		IMapEnumeratorT<String, HostProbe*>* pProbes = __probes.GetMapEnumeratorN();
+		if(pProbes) {
+			HostProbe* pCandidate = null;
+			while(pProbes->MoveNext() == E_SUCCESS) {
+				pProbes->GetValue(pCandidate);
+				if(pCandidate->pTransaction == null && (pOldest == null || pCandidate->checkedAt < pOldest->checkedAt)) {
+					pOldest = pCandidate;
+				}
+			}
+			delete pProbes;
 		}
+		if(pOldest) {
+			__probes.Remove(pOldest->host);
+			delete pOldest;
+		}
+	}
+	pProbe = new HostProbe(host);
+	__probes.Add(host, pProbe);
+	return pProbe;
 }
 
-void
-Network::IsReachable(const String& hostAddr) {
-	String* pProxyAddr = null;
-	//String hostAddr = L"http://localhost:port";
-	AppLogDebug("Trying to reach...%S", hostAddr.GetPointer());
-	__pHttpSession = new HttpSession();
-	__pHttpSession->Construct(NET_HTTP_SESSION_MODE_NORMAL, pProxyAddr, hostAddr, null);
-	HttpTransaction* pHttpTransaction = __pHttpSession->OpenTransactionN();
+HostProbe*
+Network::FindProbe(const HttpTransaction& httpTransaction) {
+	HostProbe* pFound = null;
+	IMapEnumeratorT<String, HostProbe*>* pProbes = __probes.GetMapEnumeratorN();
+	if(pProbes) {
+		HostProbe* pProbe = null;
+		while(pFound == null && pProbes->MoveNext() == E_SUCCESS) {
+			pProbes->GetValue(pProbe);
+			if(pProbe->pTransaction == &httpTransaction) {
+				pFound = pProbe;
+			}
+		}
+		delete pProbes;
+	}
+	return pFound;
+}
+
+result
+Network::Submit(HostProbe* pProbe, const String& uri) {
+	AppLogDebug("Trying to reach...%S", uri.GetPointer());
+	if(pProbe->pSession == null) {
+		pProbe->pSession = new HttpSession();
+		result r = pProbe->pSession->Construct(NET_HTTP_SESSION_MODE_NORMAL, null, pProbe->host, null);
+		if(IsFailed(r)) {
+			AppLogException("Could not open a session to %S", pProbe->host.GetPointer());
+			delete pProbe->pSession;
+			pProbe->pSession = null;
+			return r;
+		}
+	}
+	HttpTransaction* pHttpTransaction = pProbe->pSession->OpenTransactionN();
+	if(pHttpTransaction == null) {
+		// The session is unusable, the next probe opens a new one
+		result r = GetLastResult();
+		delete pProbe->pSession;
+		pProbe->pSession = null;
+		return r;
+	}
 	pHttpTransaction->AddHttpTransactionListener(*this);
+	// Only the status line matters, HEAD spares the body
 	HttpRequest* pHttpRequest = pHttpTransaction->GetRequest();
-	pHttpRequest->SetMethod(NET_HTTP_METHOD_GET);
-	pHttpRequest->SetUri(hostAddr);
-	pHttpTransaction->Submit();
+	pHttpRequest->SetMethod(NET_HTTP_METHOD_HEAD);
+	pHttpRequest->SetUri(uri);
+	result r = pHttpTransaction->Submit();
+	if(IsFailed(r)) {
+		pProbe->pSession->CloseTransaction(*pHttpTransaction);
+		return r;
+	}
+	pProbe->pTransaction = pHttpTransaction;
+	return E_SUCCESS;
 }
 
 void
-Network::OnTransactionAborted (HttpSession &httpSession, HttpTransaction &httpTransaction, result r) {
-	AppLogDebug("Transaction Aborted");
-	String res;
-	res.Format(128, L"PhoneGap.callbacks['%S'].fail({code:%d,message:'%s'});", callbackId.GetPointer(), r, GetErrorMessage(r));
-	AppLogDebug("%S", res.GetPointer());
-	pWeb->EvaluateJavascriptN(res);
-}
+Network::Finish(HostProbe* pProbe, result r, int httpCode) {
+	pProbe->pTransaction = null;
+	pProbe->valid = true;
+	pProbe->error = r;
+	pProbe->httpCode = httpCode;
+	pProbe->status = CONNECTION_NONE;
+	if(r == E_SUCCESS) {
+		// The host answered, some data connection is up even if the events did not tell which one
+		pProbe->status = __monitor.GetType() == CONNECTION_NONE ? CONNECTION_CELLULAR : __monitor.GetType();
+	}
+	pProbe->checkedAt = GetTicks();
 
-void
-Network::OnTransactionCompleted (HttpSession &httpSession, HttpTransaction &httpTransaction) {
-	HttpResponse* pHttpResponse = httpTransaction.GetResponse();
-	NetHttpStatusCode statusCode = pHttpResponse->GetStatusCode();
-	int status = 1; // Default is DATA NETWORK
+	if(r == E_SUCCESS) {
+		ScriptBuilder* pScript = ScriptBuilder::Acquire();
+		pScript->BeginCall(L"navigator.network.updateReachability").BeginObject()
+				.Member(L"code").AppendInt(pProbe->status)
+				.Member(L"http_code").AppendInt(httpCode)
+				.EndObject().EndCall().AppendRaw(L";");
+		AppLogDebug("%S", pScript->GetString().GetPointer());
+		pResults->Enqueue(pScript->GetString());
+		ScriptBuilder::Release(pScript);
+	}
 
-	// FIXME: Bada has no standard/apparent way of knowing the current network type
-	// We have to get the network type from the system info
-	// ...and if Wifi is enabled we override the setting to Wifi
+	for(int i = 0 ; i < pProbe->callbacks.GetCount() ; i++) {
+		String callbackId;
+		pProbe->callbacks.GetAt(i, callbackId);
+		SendStatus(callbackId, pProbe);
+	}
+	pProbe->callbacks.RemoveAll();
+}
 
-	String key(L"NetworkType");
-	String networkType;
+void
+Network::SendStatus(const String& callbackId, const HostProbe* pProbe) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	if(pProbe->error == E_SUCCESS) {
+		pScript->BeginCallback(callbackId, L"success").AppendInt(pProbe->status).EndCallback();
+	} else {
+		pScript->BeginCallback(callbackId, L"fail").BeginObject()
+				.Member(L"code").AppendInt(pProbe->error)
+				.Member(L"message").AppendString(String(GetErrorMessage(pProbe->error)))
+				.EndObject().EndCallback();
+	}
+	AppLogDebug("%S", pScript->GetString().GetPointer());
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
 
-	result r = SystemInfo::GetValue(key, networkType);
+void
+Network::SendConnection(ConnectionType type) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCall(L"navigator.network.updateConnection").AppendString(ConnectionMonitor::GetTypeName(type)).EndCall().AppendRaw(L";");
+	AppLogDebug("%S", pScript->GetString().GetPointer());
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
 
-	if(r == E_SUCCESS && networkType != L"NoService" && networkType != L"Emergency") {
-		AppLogDebug("Data Enabled, Network Type %S, Status Code: %d", networkType.GetPointer(), statusCode);
-		status = 1;
+void
+Network::OnConnectionChanged(ConnectionType type) {
+	// Answers obtained over the previous connection say nothing about this one
+	IMapEnumeratorT<String, HostProbe*>* pProbes = __probes.GetMapEnumeratorN();
+	if(pProbes) {
+		HostProbe* pProbe = null;
+		while(pProbes->MoveNext() == E_SUCCESS) {
+			pProbes->GetValue(pProbe);
+			pProbe->valid = false;
+		}
+		delete pProbes;
 	}
-
-	Wifi::WifiManager manager;
-	if(manager.IsActivated() && manager.IsConnected()) {
-		AppLogDebug("Wifi Enabled");
-		status = 2;
+	if(__watchingConnection) {
+		SendConnection(type);
 	}
+}
 
-	String res;
-
-	res.Format(256, L"navigator.network.updateReachability({code:%d,http_code:%d});", status, statusCode);
-	AppLogDebug("%S", res.GetPointer());
-	pWeb->EvaluateJavascriptN(res);
+void
+Network::OnTransactionAborted (HttpSession &httpSession, HttpTransaction &httpTransaction, result r) {
+	AppLogDebug("Transaction Aborted");
+	HostProbe* pProbe = FindProbe(httpTransaction);
+	httpSession.CloseTransaction(httpTransaction);
+	if(pProbe) {
+		Finish(pProbe, r, 0);
+	}
+}
 
-	res.Format(128, L"PhoneGap.callbacks['%S'].success(%d);", callbackId.GetPointer(), status);
-	AppLogDebug("%S", res.GetPointer());
-	pWeb->EvaluateJavascriptN(res);
+void
+Network::OnTransactionCompleted (HttpSession &httpSession, HttpTransaction &httpTransaction) {
+	HttpResponse* pHttpResponse = httpTransaction.GetResponse();
+	int statusCode = pHttpResponse ? pHttpResponse->GetStatusCode() : 0;
+	AppLogDebug("Status Code: %d", statusCode);
+	HostProbe* pProbe = FindProbe(httpTransaction);
+	// The session stays open for the next probe of this host
+	httpSession.CloseTransaction(httpTransaction);
+	if(pProbe) {
+		Finish(pProbe, E_SUCCESS, statusCode);
+	}
 }
@@ -6,58 +6,60 @@
  */
 
 #include "../inc/Notification.h"
+#include "../inc/CommandRegistry.h"
 
-Notification::Notification(Web* pWeb) : PhoneGapCommand(pWeb) {
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Notification", Notification)
+
+Notification::Notification(Web* pWeb) : PhoneGapCommand(pWeb), __playing(false), __pTouchEffect(null) {
+	__steps.Construct(8);
+	__stepTimer.Construct(*this);
+	__vibrator.Construct();
 }
 
 Notification::~Notification() {
+	Cancel();
+	delete __pTouchEffect;
 }
 
 void
-Notification::Run(const String& command) {
-	if(!command.IsEmpty()) {
-		Uri commandUri;
-		commandUri.SetUri(command);
-		String method = commandUri.GetHost();
-		StringTokenizer strTok(commandUri.GetPath(), L"/");
-		if(strTok.GetTokenCount() < 1) {
-			AppLogException("Not enough params");
+Notification::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	if(method == L"alert" || method == L"confirm") {
+		callbackId = args.GetCallbackId();
+		AppLogDebug("%S %S", method.GetPointer(), callbackId.GetPointer());
+		if(!callbackId.IsEmpty()) {
+			Dialog();
+		}
+	} else if(method == L"vibrate") {
+		long duration;
+
+		AppLogDebug("%S %S", method.GetPointer(), args.GetString(0).GetPointer());
+		// Parsing duration, or a vibrate,pause,vibrate... pattern
+		int comma;
+		if(args.GetString(0).IndexOf(L',', 0, comma) == E_SUCCESS) {
+			Vibrate(args.GetString(0));
 			return;
 		}
-		if((method == L"com.phonegap.Notification.alert" || method == L"com.phonegap.Notification.confirm")) {
-			strTok.GetNextToken(callbackId);
-			AppLogDebug("%S %S", method.GetPointer(), callbackId.GetPointer());
-			if(!callbackId.IsEmpty()) {
-				Dialog();
-			}
-		} else if(method == L"com.phonegap.Notification.vibrate") {
-			long duration;
-			String durationStr;
-
-			strTok.GetNextToken(durationStr);
-			AppLogDebug("%S %S", method.GetPointer(), durationStr.GetPointer());
-			// Parsing duration
-			result r = Long::Parse(durationStr, duration);
-			if(IsFailed(r)) {
-				AppLogException("Could not parse duration");
-				return;
-			}
-			Vibrate(duration);
-		} else if(method == L"com.phonegap.Notification.beep") {
-			int count;
-			String countStr;
-
-			strTok.GetNextToken(countStr);
-			AppLogDebug("%S %S", method.GetPointer(), countStr.GetPointer());
-			// Parsing count
-			result r = Integer::Parse(countStr, count);
-			if(IsFailed(r)) {
-				AppLogException("Could not parse count");
-				return;
-			}
+		result r = args.GetLong(0, duration);
+		if(IsFailed(r)) {
+			AppLogException("Could not parse duration");
+			return;
+		}
+		Vibrate(duration);
+	} else if(method == L"beep") {
+		int count;
 
-			Beep(count);
+		AppLogDebug("%S %S", method.GetPointer(), args.GetString(0).GetPointer());
+		// Parsing count
+		result r = args.GetInt(0, count);
+		if(IsFailed(r)) {
+			AppLogException("Could not parse count");
+			return;
 		}
+
+		Beep(count);
+	} else if(method == L"cancel") {
+		Cancel();
 	}
 }
 
@@ -67,7 +69,6 @@ Notification::Dialog() {
 	String* title;
 	String* message;
 	String* styleStr;
-	String eval;
 
 	title = pWeb->EvaluateJavascriptN(L"navigator.notification.messageBox.title");
 	message = pWeb->EvaluateJavascriptN(L"navigator.notification.messageBox.message");
@@ -79,52 +80,52 @@ Notification::Dialog() {
 		int modalResult = 0;
 		if(Integer::Parse(*styleStr, style) != E_SUCCESS) {
 			AppLogException("Could not get dialog style");
+			delete title;
+			delete message;
+			delete styleStr;
 			return;
 		}
 		messageBox.Construct(*title, *message, (MessageBoxStyle)style, 0);
 		messageBox.ShowAndWait(modalResult);
+		const mchar* pButton = null;
 		switch(modalResult) {
 		case MSGBOX_RESULT_CLOSE:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Close')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Close";
 			break;
 		case MSGBOX_RESULT_OK:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('OK')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"OK";
 			break;
 		case MSGBOX_RESULT_CANCEL:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Cancel')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Cancel";
 			break;
 		case MSGBOX_RESULT_YES:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Yes')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Yes";
 			break;
 		case MSGBOX_RESULT_NO:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('No')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"No";
 			break;
 		case MSGBOX_RESULT_ABORT:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Abort')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Abort";
 			break;
 		case MSGBOX_RESULT_TRY:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Try')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Try";
 			break;
 		case MSGBOX_RESULT_RETRY:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Retry')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Retry";
 			break;
 		case MSGBOX_RESULT_IGNORE:
-			eval.Format(128, L"PhoneGap.callbacks['%S'].success('Ignore')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Ignore";
 			break;
 		case MSGBOX_RESULT_CONTINUE:
-			eval.Format(64, L"PhoneGap.callbacks['%S'].success('Continue')", callbackId.GetPointer());
-			pWeb->EvaluateJavascriptN(eval);
+			pButton = L"Continue";
 			break;
 		}
+		if(pButton) {
+			ScriptBuilder* pScript = ScriptBuilder::Acquire();
+			pScript->BeginCallback(callbackId, L"success").AppendString(pButton).EndCallback();
+			pResults->Enqueue(pScript->GetString());
+			ScriptBuilder::Release(pScript);
+		}
 
 	} else {
 		AppLogException("Could not construct MessageBox");
@@ -133,27 +134,96 @@ Notification::Dialog() {
 	delete message;
 	delete styleStr;
 }
-void Notification::Vibrate(const long milliseconds) {
+void
+Notification::Vibrate(const long milliseconds) {
 	AppLogDebug("Trying to vibrate the device for %d", milliseconds);
-	Vibrator vibrator;
-	vibrator.Construct();
-	vibrator.Start(milliseconds, 99);
-	Osp::Base::Runtime::Thread::Sleep(milliseconds + 1000);
+	if(milliseconds > 0) {
+		AddStep(milliseconds);
+	}
 }
 
-void Notification::Beep(const int count) {
+void
+Notification::Vibrate(const String& pattern) {
+	AppLogDebug("Trying to vibrate the device with %S", pattern.GetPointer());
+	StringTokenizer tokenizer(pattern, L",");
+	String token;
+	bool vibrate = true;
+	while(tokenizer.HasMoreTokens()) {
+		tokenizer.GetNextToken(token);
+		long duration = 0;
+		if(Long::Parse(token, duration) == E_SUCCESS && duration > 0) {
+			AddStep(vibrate ? duration : -duration);
+		}
+		vibrate = !vibrate;
+	}
+}
+
+void
+Notification::Beep(const int count) {
 	AppLogDebug("Trying to beep the device");
-	result r = E_SUCCESS;
+	for(int i = 0 ; i < count ; i++) {
+		AddStep(0);
+	}
+}
 
-	TouchEffect *pTouchEffect = null;
-	pTouchEffect = new Osp::Uix::TouchEffect();
+void
+Notification::Cancel(void) {
+	__stepTimer.Cancel();
+	__steps.RemoveAll();
+	if(__playing) {
+		__vibrator.Stop();
+		__playing = false;
+	}
+}
 
-	r = pTouchEffect->Construct();
+void
+Notification::AddStep(long step) {
+	if(__steps.GetCount() >= MAX_STEPS) {
+		AppLogException("Too many notifications pending, dropping one");
+		return;
+	}
+	__steps.Add(step);
+	if(!__playing) {
+		PlayNextStep();
+	}
+}
 
-	if(r == E_SUCCESS) {
-		for(int i = 0 ; i < count && r == E_SUCCESS ; i++) {
-			r = pTouchEffect->Play(TOUCH_EFFECT_SOUND);
-			Osp::Base::Runtime::Thread::Sleep(1000);
+void
+Notification::PlayNextStep(void) {
+	long step = 0;
+	if(__steps.GetCount() == 0 || __steps.GetAt(0, step) != E_SUCCESS) {
+		__playing = false;
+		return;
+	}
+	__steps.RemoveAt(0);
+	__playing = true;
+
+	long duration = step;
+	if(step > 0) {
+		__vibrator.Start(step, 99);
+	} else if(step < 0) {
+		duration = -step;
+	} else {
+		if(__pTouchEffect == null) {
+			__pTouchEffect = new TouchEffect();
+			if(IsFailed(__pTouchEffect->Construct())) {
+				AppLogException("Could not construct touch effect");
+				delete __pTouchEffect;
+				__pTouchEffect = null;
+			}
+		}
+		if(__pTouchEffect) {
+			__pTouchEffect->Play(TOUCH_EFFECT_SOUND);
 		}
+		duration = BEEP_INTERVAL;
 	}
+	if(IsFailed(__stepTimer.Start(duration))) {
+		AppLogException("Could not schedule the next notification");
+		Cancel();
+	}
+}
+
+void
+Notification::OnTimerExpired(Timer& timer) {
+	PlayNextStep();
 }
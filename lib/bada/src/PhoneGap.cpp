@@ -15,6 +15,7 @@ using namespace Osp::Ui;
 using namespace Osp::Ui::Controls;
 
 PhoneGap::PhoneGap()
+	: __pWebForm(null), __background(false), __screenOff(false)
 {
 }
 
@@ -39,8 +40,8 @@ PhoneGap::OnAppInitializing(AppRegistry& appRegistry)
 	// If this method is successful, return true; otherwise, return false.
 	// If this method returns false, the application will be terminated.
 
-	// Uncomment the following statement to listen to the screen on/off events.
-	//PowerManager::SetScreenEventListener(*this);
+	// Sensors and location are suspended while the screen is off
+	PowerManager::SetScreenEventListener(*this);
 
 	Frame *pFrame = null;
 	result r = E_SUCCESS;
@@ -65,6 +66,7 @@ PhoneGap::OnAppInitializing(AppRegistry& appRegistry)
 	// Draw and Show the form
 	pWebForm->Draw();
 	pWebForm->Show();
+	__pWebForm = pWebForm;
 
 	return true;
 
@@ -75,6 +77,8 @@ CATCH:
 bool
 PhoneGap::OnAppTerminating(AppRegistry& appRegistry, bool forcedTermination)
 {
+	// The form is deleted with the frame
+	__pWebForm = null;
 	// TODO:
 	// Deallocate resources allocated by this application for termination.
 	// The application's permanent data and context can be saved via appRegistry.
@@ -84,44 +88,59 @@ PhoneGap::OnAppTerminating(AppRegistry& appRegistry, bool forcedTermination)
 void
 PhoneGap::OnForeground(void)
 {
-	// TODO:
-	// Start or resume drawing when the application is moved to the foreground.
+	__background = false;
+	UpdateSuspension();
 }
 
 void
 PhoneGap::OnBackground(void)
 {
-	// TODO:
-	// Stop drawing when the application is moved to the background.
+	__background = true;
+	UpdateSuspension();
 }
 
 void
 PhoneGap::OnLowMemory(void)
 {
-	// TODO:
-	// Free unused resources or close the application.
+	if(__pWebForm) {
+		__pWebForm->ReleaseMemory();
+	}
 }
 
 void
 PhoneGap::OnBatteryLevelChanged(BatteryLevel batteryLevel)
 {
-	// TODO:
-	// Handle any changes in battery level here.
-	// Stop using multimedia features(camera, mp3 etc.) if the battery level is CRITICAL.
+	// Handlers scale back sampling, location updates and camera previews as the battery drains
+	QosPolicy* pQos = QosPolicy::GetCurrent();
+	if(pQos) {
+		pQos->SetBatteryLevel(batteryLevel);
+	}
 }
 
 void
 PhoneGap::OnScreenOn (void)
 {
-	// TODO:
-	// Get the released resources or resume the operations that were paused or stopped in OnScreenOff().
+	__screenOff = false;
+	UpdateSuspension();
 }
 
 void
 PhoneGap::OnScreenOff (void)
 {
-	// TODO:
-	//  Unless there is a strong reason to do otherwise, release resources (such as 3D, media, and sensors) to allow the device to enter the sleep mode to save the battery.
-	// Invoking a lengthy asynchronous method within this listener method can be risky, because it is not guaranteed to invoke a callback before the device enters the sleep mode.
-	// Similarly, do not perform lengthy operations in this listener method. Any operation must be a quick one.
+	// Sensors and location are released so the device can sleep, only handler state is kept
+	__screenOff = true;
+	UpdateSuspension();
+}
+
+void
+PhoneGap::UpdateSuspension(void)
+{
+	if(__pWebForm == null) {
+		return;
+	}
+	if(__background || __screenOff) {
+		__pWebForm->Suspend();
+	} else {
+		__pWebForm->Resume();
+	}
 }
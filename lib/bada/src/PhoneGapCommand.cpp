@@ -7,10 +7,308 @@
 
 #include "PhoneGapCommand.h"
 
-PhoneGapCommand::PhoneGapCommand() : pWeb(null) {
+static int
+HexValue(mchar ch) {
+	if(ch >= L'0' && ch <= L'9') {
+		return ch - L'0';
+	}
+	if(ch >= L'a' && ch <= L'f') {
+		return ch - L'a' + 10;
+	}
+	if(ch >= L'A' && ch <= L'F') {
+		return ch - L'A' + 10;
+	}
+	return -1;
 }
-PhoneGapCommand::PhoneGapCommand(Web* pWeb) : pWeb(pWeb) {
+
+static void
+AppendCodePoint(String& str, int codePoint) {
+	if(codePoint > 0xFFFF) {
+		codePoint -= 0x10000;
+		str.Append((mchar)(0xD800 + (codePoint >> 10)));
+		str.Append((mchar)(0xDC00 + (codePoint & 0x3FF)));
+	} else {
+		str.Append((mchar)codePoint);
+	}
+}
+
+CommandArgs::CommandArgs() : __count(0), __optionCount(0) {
+}
+
+CommandArgs::~CommandArgs() {
+}
+
+void
+CommandArgs::Clear(void) {
+	// Clear() keeps the buffers allocated for the next command
+	__service.Clear();
+	__method.Clear();
+	__callbackId.Clear();
+	for(int i = 0 ; i < __count ; i++) {
+		__args[i].Clear();
+	}
+	for(int i = 0 ; i < __optionCount ; i++) {
+		__optionKeys[i].Clear();
+		__optionValues[i].Clear();
+	}
+	__count = 0;
+	__optionCount = 0;
+}
+
+void
+CommandArgs::Decode(const mchar* pChars, int start, int end, String& decoded) {
+	// Percent-decoding of UTF-8 encoded characters (encodeURIComponent)
+	int codePoint = 0;
+	int pending = 0;
+	for(int i = start ; i < end ; i++) {
+		int high, low;
+		if(pChars[i] == L'%' && i + 2 < end && (high = HexValue(pChars[i + 1])) >= 0 && (low = HexValue(pChars[i + 2])) >= 0) {
+			int byte = (high << 4) | low;
+			i += 2;
+			if(pending > 0 && (byte & 0xC0) == 0x80) {
+				codePoint = (codePoint << 6) | (byte & 0x3F);
+				if(--pending == 0) {
+					AppendCodePoint(decoded, codePoint);
+				}
+				continue;
+			}
+			pending = 0;
+			if(byte < 0x80) {
+				decoded.Append((mchar)byte);
+			} else if((byte & 0xE0) == 0xC0) {
+				codePoint = byte & 0x1F;
+				pending = 1;
+			} else if((byte & 0xF0) == 0xE0) {
+				codePoint = byte & 0x0F;
+				pending = 2;
+			} else if((byte & 0xF8) == 0xF0) {
+				codePoint = byte & 0x07;
+				pending = 3;
+			}
+		} else {
+			pending = 0;
+			decoded.Append(pChars[i]);
+		}
+	}
+}
+
+result
+CommandArgs::Parse(const String& command) {
+	Clear();
+
+	const mchar* pChars = command.GetPointer();
+	int length = command.GetLength();
+	int pos = command.StartsWith(L"gap://", 0) ? 6 : 0;
+
+	// service.method
+	int hostStart = pos;
+	int lastDot = -1;
+	while(pos < length && pChars[pos] != L'/' && pChars[pos] != L'?') {
+		if(pChars[pos] == L'.') {
+			lastDot = pos;
+		}
+		pos++;
+	}
+	int hostLength = pos - hostStart;
+	if(lastDot <= hostStart || lastDot == pos - 1) {
+		AppLogException("Malformed command %S", pChars);
+		return E_INVALID_ARG;
+	}
+	for(int i = hostStart ; i < lastDot ; i++) {
+		__service.Append(pChars[i]);
+	}
+	for(int i = lastDot + 1 ; i < pos ; i++) {
+		__method.Append(pChars[i]);
+	}
+
+	// callbackId and arguments, the callbackId is the service.method followed by a counter
+	bool first = true;
+	while(pos < length && pChars[pos] == L'/') {
+		int start = ++pos;
+		while(pos < length && pChars[pos] != L'/' && pChars[pos] != L'?') {
+			pos++;
+		}
+		if(start == pos && (pos == length || pChars[pos] == L'?')) {
+			break; // trailing slash
+		}
+		bool isCallback = false;
+		if(first && pos - start > hostLength) {
+			isCallback = true;
+			for(int i = 0 ; i < hostLength && isCallback ; i++) {
+				isCallback = pChars[start + i] == pChars[hostStart + i];
+			}
+		}
+		first = false;
+		if(isCallback) {
+			Decode(pChars, start, pos, __callbackId);
+		} else if(__count < MAX_ARGS) {
+			Decode(pChars, start, pos, __args[__count++]);
+		} else {
+			AppLogException("Too many arguments in %S.%S", __service.GetPointer(), __method.GetPointer());
+			return E_OVERFLOW;
+		}
+	}
+
+	// key=value options
+	if(pos < length && pChars[pos] == L'?') {
+		pos++;
+		while(pos < length) {
+			int start = pos;
+			int equal = -1;
+			while(pos < length && pChars[pos] != L'&') {
+				if(equal < 0 && pChars[pos] == L'=') {
+					equal = pos;
+				}
+				pos++;
+			}
+			if(pos > start && __optionCount < MAX_OPTIONS) {
+				if(equal < 0) {
+					equal = pos;
+				}
+				Decode(pChars, start, equal, __optionKeys[__optionCount]);
+				Decode(pChars, equal < pos ? equal + 1 : pos, pos, __optionValues[__optionCount]);
+				__optionCount++;
+			}
+			pos++;
+		}
+	}
+	return E_SUCCESS;
+}
+
+const String&
+CommandArgs::GetService(void) const {
+	return __service;
+}
+
+const String&
+CommandArgs::GetMethod(void) const {
+	return __method;
+}
+
+const String&
+CommandArgs::GetCallbackId(void) const {
+	return __callbackId;
+}
+
+bool
+CommandArgs::HasCallback(void) const {
+	return !__callbackId.IsEmpty();
+}
+
+int
+CommandArgs::GetCount(void) const {
+	return __count;
+}
+
+const String&
+CommandArgs::GetString(int index) const {
+	if(index < 0 || index >= __count) {
+		return __empty;
+	}
+	return __args[index];
+}
+
+result
+CommandArgs::GetInt(int index, int& value) const {
+	if(index < 0 || index >= __count) {
+		return E_OUT_OF_RANGE;
+	}
+	return Integer::Parse(__args[index], value);
+}
+
+result
+CommandArgs::GetLong(int index, long& value) const {
+	if(index < 0 || index >= __count) {
+		return E_OUT_OF_RANGE;
+	}
+	return Long::Parse(__args[index], value);
+}
+
+result
+CommandArgs::GetDouble(int index, double& value) const {
+	if(index < 0 || index >= __count) {
+		return E_OUT_OF_RANGE;
+	}
+	return Double::Parse(__args[index], value);
+}
+
+bool
+CommandArgs::GetBool(int index, bool defaultValue) const {
+	if(index < 0 || index >= __count) {
+		return defaultValue;
+	}
+	if(__args[index] == L"true" || __args[index] == L"1") {
+		return true;
+	}
+	if(__args[index] == L"false" || __args[index] == L"0") {
+		return false;
+	}
+	return defaultValue;
+}
+
+int
+CommandArgs::FindOption(const String& key) const {
+	for(int i = 0 ; i < __optionCount ; i++) {
+		if(__optionKeys[i] == key) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+const String&
+CommandArgs::GetOption(const String& key) const {
+	int index = FindOption(key);
+	return index < 0 ? __empty : __optionValues[index];
+}
+
+bool
+CommandArgs::HasOption(const String& key) const {
+	return FindOption(key) >= 0;
+}
+
+PhoneGapCommand::PhoneGapCommand() : pWeb(null), pResults(null), pWorker(null), lane(0) {
+}
+PhoneGapCommand::PhoneGapCommand(Web* pWeb) : pWeb(pWeb), pResults(null), pWorker(null), lane(0) {
 }
 
 PhoneGapCommand::~PhoneGapCommand() {
 }
+
+void
+PhoneGapCommand::SetResultQueue(ResultQueue* pResults) {
+	this->pResults = pResults;
+}
+
+void
+PhoneGapCommand::SetWorker(Worker* pWorker, int lane) {
+	this->pWorker = pWorker;
+	this->lane = lane;
+}
+
+int
+PhoneGapCommand::GetLane(void) const {
+	return lane;
+}
+
+CommandMode
+PhoneGapCommand::GetMode(void) const {
+	return COMMAND_MODE_UI_THREAD;
+}
+
+void
+PhoneGapCommand::Suspend(void) {
+}
+
+void
+PhoneGapCommand::Resume(void) {
+}
+
+long
+PhoneGapCommand::ReleaseMemory(void) {
+	return 0;
+}
+
+void
+PhoneGapCommand::ApplyQos(void) {
+}
@@ -0,0 +1,68 @@
+/*
+ * Qos.cpp
+ *
+ *  Lets the page read the quality of service policy and override its tier.
+ */
+
+#include "../inc/Qos.h"
+#include "../inc/CommandRegistry.h"
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Qos", Qos)
+
+Qos::Qos(Web* pWeb): PhoneGapCommand(pWeb) {
+	__pPolicy = QosPolicy::GetInstance();
+}
+
+Qos::~Qos() {
+	QosPolicy::ReleaseInstance();
+}
+
+void
+Qos::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	if(method == L"setTier") {
+		QosTier tier;
+		if(IsFailed(QosPolicy::ParseTier(args.GetString(0), tier))) {
+			AppLogException("Unknown QoS tier %S", args.GetString(0).GetPointer());
+			if(args.HasCallback()) {
+				ScriptBuilder* pScript = ScriptBuilder::Acquire();
+				pScript->BeginCallback(args.GetCallbackId(), L"fail").AppendString(L"Unknown tier").EndCallback();
+				pResults->Enqueue(pScript->GetString());
+				ScriptBuilder::Release(pScript);
+			}
+			return;
+		}
+		__pPolicy->SetOverride(tier);
+	} else if(method == L"clearTier") {
+		__pPolicy->ClearOverride();
+	} else if(method != L"getPolicy") {
+		return;
+	}
+	// Every method answers with the policy in effect
+	if(args.HasCallback()) {
+		SendPolicy(args.GetCallbackId());
+	}
+}
+
+void
+Qos::AppendPolicy(ScriptBuilder& script, const QosPolicy& policy) {
+	script.BeginObject()
+			.Member(L"tier").AppendString(QosPolicy::GetTierName(policy.GetTier()))
+			.Member(L"batteryTier").AppendString(QosPolicy::GetTierName(policy.GetBatteryTier()))
+			.Member(L"overridden").AppendBool(policy.IsOverridden())
+			.Member(L"sensorInterval").AppendLong(policy.GetSensorInterval())
+			.Member(L"locationInterval").AppendInt(policy.GetLocationInterval())
+			.Member(L"previewSize").AppendInt(policy.GetPreviewSize())
+			.Member(L"flushInterval").AppendInt(policy.GetFlushInterval())
+			.EndObject();
+}
+
+void
+Qos::SendPolicy(const String& callbackId) {
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success");
+	AppendPolicy(*pScript, *__pPolicy);
+	pScript->EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
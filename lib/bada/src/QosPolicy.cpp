@@ -0,0 +1,178 @@
+/*
+ * QosPolicy.cpp
+ *
+ *  Quality of service the handlers follow, in tiers chosen from the battery level:
+ *  sensor sampling, location update interval, camera preview size and how often
+ *  results are delivered to the page. The page can override the tier.
+ */
+
+#include "../inc/QosPolicy.h"
+
+static const mchar* TIER_NAMES[QOS_TIER_COUNT] = { L"normal", L"saving", L"critical" };
+// Shortest sensor sampling interval (ms)
+static const long SENSOR_INTERVALS[QOS_TIER_COUNT] = { 0, 200, 1000 };
+// Shortest location update interval (s) while watching
+static const int LOCATION_INTERVALS[QOS_TIER_COUNT] = { 0, 15, 60 };
+// Largest camera preview side (pixels)
+static const int PREVIEW_SIZES[QOS_TIER_COUNT] = { 0, 240, 120 };
+// Delay (ms) results wait for others before being delivered
+static const int FLUSH_INTERVALS[QOS_TIER_COUNT] = { 0, 100, 500 };
+
+static QosPolicy* __pInstance = null;
+static int __references = 0;
+
+QosPolicy::QosPolicy() : __pListener(null), __batteryTier(QOS_TIER_NORMAL), __override(QOS_TIER_NORMAL), __overridden(false) {
+}
+
+QosPolicy::~QosPolicy() {
+}
+
+void
+QosPolicy::Construct(void) {
+	BatteryLevel level;
+	if(Battery::GetCurrentLevel(level) == E_SUCCESS) {
+		SetBatteryLevel(level);
+	}
+}
+
+QosPolicy*
+QosPolicy::GetInstance(void) {
+	if(__pInstance == null) {
+		__pInstance = new QosPolicy();
+		__pInstance->Construct();
+	}
+	__references++;
+	return __pInstance;
+}
+
+void
+QosPolicy::ReleaseInstance(void) {
+	if(__references > 0 && --__references == 0) {
+		delete __pInstance;
+		__pInstance = null;
+	}
+}
+
+QosPolicy*
+QosPolicy::GetCurrent(void) {
+	return __pInstance;
+}
+
+const mchar*
+QosPolicy::GetTierName(QosTier tier) {
+	return tier >= 0 && tier < QOS_TIER_COUNT ? TIER_NAMES[tier] : TIER_NAMES[QOS_TIER_NORMAL];
+}
+
+result
+QosPolicy::ParseTier(const String& name, QosTier& tier) {
+	for(int i = 0 ; i < QOS_TIER_COUNT ; i++) {
+		if(name == TIER_NAMES[i]) {
+			tier = (QosTier)i;
+			return E_SUCCESS;
+		}
+	}
+	return E_INVALID_ARG;
+}
+
+long
+QosPolicy::CapSensorInterval(long milliseconds) {
+	long minimum = __pInstance ? __pInstance->GetSensorInterval() : 0;
+	return milliseconds < minimum ? minimum : milliseconds;
+}
+
+int
+QosPolicy::CapLocationInterval(int seconds) {
+	int minimum = __pInstance ? __pInstance->GetLocationInterval() : 0;
+	return seconds < minimum ? minimum : seconds;
+}
+
+int
+QosPolicy::CapPreviewSize(int pixels) {
+	int maximum = __pInstance ? __pInstance->GetPreviewSize() : 0;
+	return maximum > 0 && pixels > maximum ? maximum : pixels;
+}
+
+void
+QosPolicy::SetListener(IQosListener* pListener) {
+	__pListener = pListener;
+}
+
+void
+QosPolicy::SetBatteryLevel(BatteryLevel level) {
+	QosTier previous = GetTier();
+	switch(level) {
+	case BATTERY_CRITICAL:
+	case BATTERY_EMPTY:
+		__batteryTier = QOS_TIER_CRITICAL;
+		break;
+	case BATTERY_LOW:
+		__batteryTier = QOS_TIER_SAVING;
+		break;
+	default:
+		__batteryTier = QOS_TIER_NORMAL;
+		break;
+	}
+	Update(previous);
+}
+
+void
+QosPolicy::SetOverride(QosTier tier) {
+	QosTier previous = GetTier();
+	__override = tier;
+	__overridden = true;
+	Update(previous);
+}
+
+void
+QosPolicy::ClearOverride(void) {
+	QosTier previous = GetTier();
+	__overridden = false;
+	Update(previous);
+}
+
+void
+QosPolicy::Update(QosTier previous) {
+	QosTier tier = GetTier();
+	if(tier == previous) {
+		return;
+	}
+	AppLogDebug("QoS tier %S -> %S%s", GetTierName(previous), GetTierName(tier), __overridden ? " (overridden)" : "");
+	if(__pListener) {
+		__pListener->OnQosChanged(*this);
+	}
+}
+
+QosTier
+QosPolicy::GetTier(void) const {
+	return __overridden ? __override : __batteryTier;
+}
+
+QosTier
+QosPolicy::GetBatteryTier(void) const {
+	return __batteryTier;
+}
+
+bool
+QosPolicy::IsOverridden(void) const {
+	return __overridden;
+}
+
+long
+QosPolicy::GetSensorInterval(void) const {
+	return SENSOR_INTERVALS[GetTier()];
+}
+
+int
+QosPolicy::GetLocationInterval(void) const {
+	return LOCATION_INTERVALS[GetTier()];
+}
+
+int
+QosPolicy::GetPreviewSize(void) const {
+	return PREVIEW_SIZES[GetTier()];
+}
+
+int
+QosPolicy::GetFlushInterval(void) const {
+	return FLUSH_INTERVALS[GetTier()];
+}
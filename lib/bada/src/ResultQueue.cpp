@@ -0,0 +1,187 @@
+/*
+ * ResultQueue.cpp
+ *
+ *  Gathers the callback invocations produced by the commands and delivers them
+ *  to the Web control in a single script evaluation per flush.
+ */
+
+#include "../inc/ResultQueue.h"
+#include "../inc/Tracer.h"
+
+// Scripts bigger than this are flushed right away instead of waiting for the timer
+static const int MAX_PENDING_LENGTH = 32768;
+// Capacity the buffer starts with and goes back to when compacted
+static const int INITIAL_CAPACITY = 1024;
+
+ResultQueue::ResultQueue() : __pWeb(null), __pOwner(null), __pOwnerThread(null), __count(0), __flushInterval(0), __scheduled(false), __paused(false), __requested(false) {
+}
+
+ResultQueue::~ResultQueue() {
+	__timer.Cancel();
+}
+
+result
+ResultQueue::Construct(Web* pWeb, Control& owner) {
+	__pWeb = pWeb;
+	__pOwner = &owner;
+	__pOwnerThread = Thread::GetCurrentThread();
+	__pending.EnsureCapacity(INITIAL_CAPACITY);
+	result r = __lock.Create();
+	if(IsFailed(r)) {
+		return r;
+	}
+	return __timer.Construct(*this);
+}
+
+bool
+ResultQueue::IsOwnerThread(void) const {
+	return Thread::GetCurrentThread() == __pOwnerThread;
+}
+
+void
+ResultQueue::Enqueue(const String& script) {
+	if(script.IsEmpty()) {
+		return;
+	}
+	bool full = false;
+	__lock.Acquire();
+	full = __pending.GetLength() + script.GetLength() > MAX_PENDING_LENGTH;
+	__lock.Release();
+	if(full) {
+		Flush();
+	}
+	// Each invocation is isolated so a throwing callback does not prevent the next ones
+	__lock.Acquire();
+	__pending.Append(L"try{");
+	__pending.Append(script);
+	__pending.Append(L"}catch(e){}\n");
+	__count++;
+	__lock.Release();
+	if(IsOwnerThread()) {
+		ScheduleFlush();
+	} else {
+		RequestFlush();
+	}
+}
+
+void
+ResultQueue::RequestFlush(void) {
+	__lock.Acquire();
+	bool requested = __requested;
+	__requested = true;
+	__lock.Release();
+	if(!requested && IsFailed(__pOwner->SendUserEvent(REQUEST_FLUSH, null))) {
+		AppLogException("Could not ask for result delivery");
+		__lock.Acquire();
+		__requested = false;
+		__lock.Release();
+	}
+}
+
+void
+ResultQueue::Flush(void) {
+	if(!IsOwnerThread()) {
+		RequestFlush();
+		return;
+	}
+	if(__scheduled) {
+		__timer.Cancel();
+		__scheduled = false;
+	}
+	if(__paused) {
+		// Kept for SetPaused(false), a hidden page is not woken up unless too much is held
+		__lock.Acquire();
+		__requested = false;
+		bool held = __pending.GetLength() < MAX_PAUSED_LENGTH;
+		__lock.Release();
+		if(held) {
+			return;
+		}
+		AppLogDebug("Too many results held while paused, delivering them");
+	}
+	// Evaluated outside of the lock, workers keep enqueuing meanwhile
+	String script;
+	int count = 0;
+	__lock.Acquire();
+	__requested = false;
+	if(!__pending.IsEmpty()) {
+		script = __pending;
+		count = __count;
+		__pending.Clear();
+		__count = 0;
+	}
+	__lock.Release();
+	if(script.IsEmpty() || __pWeb == null) {
+		return;
+	}
+	AppLogDebug("Delivering %d results in one evaluation", count);
+	String* pResult = __pWeb->EvaluateJavascriptN(script);
+	delete pResult;
+	Tracer* pTracer = Tracer::GetCurrent();
+	if(pTracer) {
+		pTracer->Delivered();
+	}
+}
+
+void
+ResultQueue::SetFlushInterval(int milliseconds) {
+	__flushInterval = milliseconds < 0 ? 0 : milliseconds;
+}
+
+int
+ResultQueue::GetFlushInterval(void) const {
+	return __flushInterval;
+}
+
+void
+ResultQueue::SetPaused(bool paused) {
+	if(paused == __paused) {
+		return;
+	}
+	__paused = paused;
+	AppLogDebug("Result delivery %s", paused ? "paused" : "resumed");
+	if(!paused) {
+		Flush();
+	}
+}
+
+bool
+ResultQueue::IsPaused(void) const {
+	return __paused;
+}
+
+long
+ResultQueue::Compact(void) {
+	if(!__paused) {
+		Flush();
+	}
+	long freed = 0;
+	__lock.Acquire();
+	int capacity = __pending.GetCapacity();
+	if(__pending.IsEmpty() && capacity > INITIAL_CAPACITY && __pending.SetCapacity(INITIAL_CAPACITY) == E_SUCCESS) {
+		freed = (capacity - __pending.GetCapacity()) * sizeof(mchar);
+	}
+	__lock.Release();
+	return freed;
+}
+
+void
+ResultQueue::ScheduleFlush(void) {
+	if(__scheduled || __paused) {
+		return;
+	}
+	// An interval of 0 flushes on the next turn of the event loop
+	result r = __timer.Start(__flushInterval > 0 ? __flushInterval : 1);
+	if(IsFailed(r)) {
+		AppLogException("Could not schedule result delivery, flushing now");
+		Flush();
+		return;
+	}
+	__scheduled = true;
+}
+
+void
+ResultQueue::OnTimerExpired(Timer& timer) {
+	__scheduled = false;
+	Flush();
+}
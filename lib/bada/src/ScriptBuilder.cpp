@@ -0,0 +1,403 @@
+/*
+ * ScriptBuilder.cpp
+ *
+ *  Builds the scripts sent back to the page: escaped string literals, full precision
+ *  numbers and comma handling for objects, arrays and call arguments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../inc/ScriptBuilder.h"
+#include "../inc/Tracer.h"
+
+using namespace Osp::Base::Runtime;
+
+static const int MAX_POOLED = 8;
+// Builders that grew bigger than this are freed instead of being kept in the pool
+static const int MAX_POOLED_CAPACITY = 65536;
+
+static ScriptBuilder* __pool[MAX_POOLED];
+static int __pooled = 0;
+static Mutex* __pPoolLock = null;
+
+static int
+GetLength(const mchar* pChars) {
+	int length = 0;
+	while(pChars[length]) {
+		length++;
+	}
+	return length;
+}
+
+ScriptBuilder::ScriptBuilder() : __depth(0), __afterName(false) {
+	__hasValue[0] = false;
+}
+
+ScriptBuilder::~ScriptBuilder() {
+}
+
+result
+ScriptBuilder::Construct(int capacity) {
+	return __script.EnsureCapacity(capacity);
+}
+
+result
+ScriptBuilder::InitializePool(void) {
+	if(__pPoolLock) {
+		return E_SUCCESS;
+	}
+	__pPoolLock = new Mutex();
+	result r = __pPoolLock->Create();
+	if(IsFailed(r)) {
+		delete __pPoolLock;
+		__pPoolLock = null;
+	}
+	return r;
+}
+
+ScriptBuilder*
+ScriptBuilder::Acquire(void) {
+	ScriptBuilder* pBuilder = null;
+	if(__pPoolLock) {
+		__pPoolLock->Acquire();
+	}
+	if(__pooled > 0) {
+		pBuilder = __pool[--__pooled];
+	}
+	if(__pPoolLock) {
+		__pPoolLock->Release();
+	}
+	if(pBuilder) {
+		pBuilder->Clear();
+		return pBuilder;
+	}
+	pBuilder = new ScriptBuilder();
+	pBuilder->Construct();
+	return pBuilder;
+}
+
+void
+ScriptBuilder::Release(ScriptBuilder* pBuilder) {
+	if(pBuilder == null) {
+		return;
+	}
+	bool pooled = false;
+	if(__pPoolLock) {
+		__pPoolLock->Acquire();
+	}
+	if(__pooled < MAX_POOLED && pBuilder->__script.GetCapacity() <= MAX_POOLED_CAPACITY) {
+		__pool[__pooled++] = pBuilder;
+		pooled = true;
+	}
+	if(__pPoolLock) {
+		__pPoolLock->Release();
+	}
+	if(!pooled) {
+		delete pBuilder;
+	}
+}
+
+long
+ScriptBuilder::ShrinkPool(void) {
+	ScriptBuilder* pool[MAX_POOLED];
+	int count = 0;
+	if(__pPoolLock) {
+		__pPoolLock->Acquire();
+	}
+	while(__pooled > 0) {
+		pool[count++] = __pool[--__pooled];
+	}
+	if(__pPoolLock) {
+		__pPoolLock->Release();
+	}
+	long freed = 0;
+	for(int i = 0 ; i < count ; i++) {
+		freed += sizeof(ScriptBuilder) + pool[i]->__script.GetCapacity() * sizeof(mchar);
+		delete pool[i];
+	}
+	return freed;
+}
+
+ScriptBuilder&
+ScriptBuilder::Clear(void) {
+	// Clear() keeps the buffer
+	__script.Clear();
+	__depth = 0;
+	__hasValue[0] = false;
+	__afterName = false;
+	return *this;
+}
+
+const String&
+ScriptBuilder::GetString(void) const {
+	return __script;
+}
+
+int
+ScriptBuilder::GetLength(void) const {
+	return __script.GetLength();
+}
+
+void
+ScriptBuilder::Reserve(int length) {
+	// Geometric growth, appending never reallocates more than log(n) times
+	int needed = __script.GetLength() + length + 1;
+	int capacity = __script.GetCapacity();
+	if(needed > capacity) {
+		capacity *= 2;
+		__script.EnsureCapacity(capacity > needed ? capacity : needed);
+	}
+}
+
+void
+ScriptBuilder::Separate(void) {
+	if(__afterName) {
+		__afterName = false;
+		return;
+	}
+	if(__depth == 0) {
+		return;
+	}
+	if(__hasValue[__depth]) {
+		Reserve(1);
+		__script.Append(L',');
+	} else {
+		__hasValue[__depth] = true;
+	}
+}
+
+void
+ScriptBuilder::Open(mchar ch) {
+	Reserve(1);
+	__script.Append(ch);
+	if(__depth < MAX_DEPTH - 1) {
+		__depth++;
+		__hasValue[__depth] = false;
+	} else {
+		AppLogException("Script nested too deeply");
+	}
+}
+
+void
+ScriptBuilder::Close(mchar ch) {
+	Reserve(1);
+	__script.Append(ch);
+	__afterName = false;
+	if(__depth > 0) {
+		__depth--;
+	}
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendRaw(const mchar* pScript) {
+	Reserve(::GetLength(pScript));
+	__script.Append(pScript);
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendRaw(const String& script) {
+	Reserve(script.GetLength());
+	__script.Append(script);
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendString(const mchar* pValue) {
+	AppendEscaped(pValue, ::GetLength(pValue));
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendString(const String& value) {
+	AppendEscaped(value.GetPointer(), value.GetLength());
+	return *this;
+}
+
+void
+ScriptBuilder::AppendEscaped(const mchar* pChars, int length) {
+	Separate();
+	Reserve(length + 2);
+	__script.Append(L'"');
+	for(int i = 0 ; i < length ; i++) {
+		mchar ch = pChars[i];
+		switch(ch) {
+		case L'"': Reserve(2); __script.Append(L"\\\""); break;
+		case L'\\': Reserve(2); __script.Append(L"\\\\"); break;
+		case L'\n': Reserve(2); __script.Append(L"\\n"); break;
+		case L'\r': Reserve(2); __script.Append(L"\\r"); break;
+		case L'\t': Reserve(2); __script.Append(L"\\t"); break;
+		default:
+			// Control characters and line separators are not valid inside a script literal,
+			// </ is split so a value can not close an enclosing script tag
+			if(ch < 0x20 || ch == 0x2028 || ch == 0x2029 || (ch == L'/' && i > 0 && pChars[i - 1] == L'<')) {
+				static const mchar hex[] = L"0123456789abcdef";
+				Reserve(6);
+				__script.Append(L"\\u");
+				__script.Append(hex[(ch >> 12) & 0xF]);
+				__script.Append(hex[(ch >> 8) & 0xF]);
+				__script.Append(hex[(ch >> 4) & 0xF]);
+				__script.Append(hex[ch & 0xF]);
+			} else {
+				__script.Append(ch);
+			}
+			break;
+		}
+	}
+	__script.Append(L'"');
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendInt(int value) {
+	Separate();
+	Reserve(12);
+	__script.Append(value);
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendLong(long long value) {
+	Separate();
+	Reserve(21);
+	__script.Append(value);
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendDouble(double value) {
+	// NaN and infinities have no JSON representation
+	if(value != value || value - value != 0) {
+		return AppendNull();
+	}
+	// Shortest of 15 or 17 significant digits that reads back as the same double
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.15g", value);
+	if(strtod(buffer, null) != value) {
+		snprintf(buffer, sizeof(buffer), "%.17g", value);
+	}
+	AppendNumber(buffer);
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendFloat(float value) {
+	if(value != value || value - value != 0) {
+		return AppendNull();
+	}
+	// Sensor values are floats, 9 digits are enough to read them back
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.7g", value);
+	if((float)strtod(buffer, null) != value) {
+		snprintf(buffer, sizeof(buffer), "%.9g", value);
+	}
+	AppendNumber(buffer);
+	return *this;
+}
+
+void
+ScriptBuilder::AppendNumber(const char* pNumber) {
+	Separate();
+	Reserve(32);
+	for(const char* p = pNumber ; *p ; p++) {
+		__script.Append((mchar)*p);
+	}
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendBool(bool value) {
+	Separate();
+	Reserve(5);
+	__script.Append(value ? L"true" : L"false");
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendNull(void) {
+	Separate();
+	Reserve(4);
+	__script.Append(L"null");
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::AppendExpression(const mchar* pExpression) {
+	Separate();
+	return AppendRaw(pExpression);
+}
+
+ScriptBuilder&
+ScriptBuilder::BeginObject(void) {
+	Separate();
+	Open(L'{');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::EndObject(void) {
+	Close(L'}');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::Member(const mchar* pName) {
+	Separate();
+	AppendRaw(pName);
+	__script.Append(L':');
+	__afterName = true;
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::BeginArray(void) {
+	Separate();
+	Open(L'[');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::EndArray(void) {
+	Close(L']');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::BeginCall(const mchar* pFunction) {
+	Separate();
+	AppendRaw(pFunction);
+	Open(L'(');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::EndCall(void) {
+	Close(L')');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::BeginCallback(const String& callbackId, const mchar* pMethod) {
+	Tracer* pTracer = Tracer::GetCurrent();
+	if(pTracer) {
+		pTracer->Answered(callbackId);
+	}
+	Separate();
+	AppendRaw(L"PhoneGap.callbacks[");
+	// The callback id is a value of its own, not an argument of the call
+	bool afterName = __afterName;
+	int depth = __depth;
+	__afterName = true;
+	AppendString(callbackId);
+	__afterName = afterName;
+	__depth = depth;
+	AppendRaw(L"].");
+	AppendRaw(pMethod);
+	Open(L'(');
+	return *this;
+}
+
+ScriptBuilder&
+ScriptBuilder::EndCallback(void) {
+	Close(L')');
+	AppendRaw(L";");
+	return *this;
+}
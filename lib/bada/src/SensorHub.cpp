@@ -0,0 +1,219 @@
+/*
+ * SensorHub.cpp
+ *
+ *  Single SensorManager shared by the sensor handlers. Any number of watchers can
+ *  listen to a sensor type, the sensor runs at the smallest interval they asked for
+ *  and is released when the last of them leaves.
+ */
+
+#include <FSystem.h>
+#include "../inc/SensorHub.h"
+
+using namespace Osp::System;
+
+static SensorHub* __pInstance = null;
+static int __references = 0;
+
+SensorHub::SensorHub() : __dispatching(false) {
+}
+
+SensorHub::~SensorHub() {
+	// As during a dispatch, the list is only compacted once every watcher left
+	__dispatching = true;
+	for(int i = 0 ; i < __watchers.GetCount() ; i++) {
+		SensorWatcher* pWatcher = null;
+		__watchers.GetAt(i, pWatcher);
+		if(pWatcher && pWatcher->pListener) {
+			RemoveWatcher(*pWatcher->pListener, pWatcher->type);
+		}
+	}
+	Compact();
+}
+
+result
+SensorHub::Construct(void) {
+	result r = __watchers.Construct(4);
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __intervals.Construct(4);
+	if(IsFailed(r)) {
+		return r;
+	}
+	return __sensorMgr.Construct();
+}
+
+SensorHub*
+SensorHub::GetInstance(void) {
+	if(__pInstance == null) {
+		__pInstance = new SensorHub();
+		if(IsFailed(__pInstance->Construct())) {
+			AppLogException("Could not construct sensor manager");
+		}
+	}
+	__references++;
+	return __pInstance;
+}
+
+void
+SensorHub::ReleaseInstance(void) {
+	if(__references > 0 && --__references == 0) {
+		delete __pInstance;
+		__pInstance = null;
+	}
+}
+
+bool
+SensorHub::IsAvailable(SensorType type) {
+	return __sensorMgr.IsAvailable(type);
+}
+
+int
+SensorHub::Find(ISensorEventListener& listener, SensorType type) const {
+	for(int i = 0 ; i < __watchers.GetCount() ; i++) {
+		SensorWatcher* pWatcher = null;
+		__watchers.GetAt(i, pWatcher);
+		if(pWatcher && pWatcher->pListener == &listener && pWatcher->type == type) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool
+SensorHub::IsWatching(ISensorEventListener& listener, SensorType type) const {
+	return Find(listener, type) >= 0;
+}
+
+long
+SensorHub::GetInterval(SensorType type) const {
+	long interval = 0;
+	for(int i = 0 ; i < __watchers.GetCount() ; i++) {
+		SensorWatcher* pWatcher = null;
+		__watchers.GetAt(i, pWatcher);
+		if(pWatcher && pWatcher->pListener && pWatcher->type == type && (interval == 0 || pWatcher->interval < interval)) {
+			interval = pWatcher->interval;
+		}
+	}
+	return interval;
+}
+
+result
+SensorHub::Update(SensorType type) {
+	long current = 0;
+	__intervals.GetValue(type, current);
+	long interval = GetInterval(type);
+	if(interval > 0) {
+		long minInterval = 0;
+		long maxInterval = 0;
+		if(__sensorMgr.GetMinInterval(type, minInterval) == E_SUCCESS && interval < minInterval) {
+			interval = minInterval;
+		}
+		if(__sensorMgr.GetMaxInterval(type, maxInterval) == E_SUCCESS && interval > maxInterval) {
+			interval = maxInterval;
+		}
+	}
+	if(interval == current) {
+		return E_SUCCESS;
+	}
+
+	result r = E_SUCCESS;
+	if(interval == 0) {
+		r = __sensorMgr.RemoveSensorListener(*this, type);
+		AppLogDebug("Stopped sensor %d", type);
+	} else if(current == 0) {
+		r = __sensorMgr.AddSensorListener(*this, type, interval, true);
+		AppLogDebug("Started sensor %d every %d ms", type, interval);
+	} else {
+		r = __sensorMgr.SetInterval(*this, type, interval);
+		AppLogDebug("Sensor %d now every %d ms", type, interval);
+	}
+	if(IsFailed(r)) {
+		AppLogException("Could not update sensor %d", type);
+		return r;
+	}
+	__intervals.Remove(type);
+	if(interval > 0) {
+		__intervals.Add(type, interval);
+	}
+	return E_SUCCESS;
+}
+
+result
+SensorHub::AddWatcher(ISensorEventListener& listener, SensorType type, long interval) {
+	if(!IsAvailable(type)) {
+		return E_DEVICE_UNAVAILABLE;
+	}
+	SensorWatcher* pWatcher = null;
+	int index = Find(listener, type);
+	if(index >= 0) {
+		__watchers.GetAt(index, pWatcher);
+	} else {
+		pWatcher = new SensorWatcher();
+		pWatcher->pListener = &listener;
+		pWatcher->type = type;
+		pWatcher->lastDelivery = 0;
+		__watchers.Add(pWatcher);
+	}
+	pWatcher->interval = interval > 0 ? interval : 1;
+	result r = Update(type);
+	if(IsFailed(r) && index < 0) {
+		RemoveWatcher(listener, type);
+	}
+	return r;
+}
+
+result
+SensorHub::RemoveWatcher(ISensorEventListener& listener, SensorType type) {
+	int index = Find(listener, type);
+	if(index < 0) {
+		return E_OBJ_NOT_FOUND;
+	}
+	SensorWatcher* pWatcher = null;
+	__watchers.GetAt(index, pWatcher);
+	// Watchers may leave from their own callback, the list is compacted after the dispatch
+	pWatcher->pListener = null;
+	if(!__dispatching) {
+		Compact();
+	}
+	return Update(type);
+}
+
+void
+SensorHub::Compact(void) {
+	for(int i = __watchers.GetCount() - 1 ; i >= 0 ; i--) {
+		SensorWatcher* pWatcher = null;
+		__watchers.GetAt(i, pWatcher);
+		if(pWatcher == null || pWatcher->pListener == null) {
+			__watchers.RemoveAt(i);
+			delete pWatcher;
+		}
+	}
+}
+
+void
+SensorHub::OnDataReceived(SensorType sensorType, SensorData& sensorData, result r) {
+	long long now = 0;
+	SystemTime::GetTicks(now);
+	long current = 0;
+	__intervals.GetValue(sensorType, current);
+
+	__dispatching = true;
+	// Watchers added during the dispatch wait for the next sample
+	int count = __watchers.GetCount();
+	for(int i = 0 ; i < count ; i++) {
+		SensorWatcher* pWatcher = null;
+		__watchers.GetAt(i, pWatcher);
+		if(pWatcher == null || pWatcher->pListener == null || pWatcher->type != sensorType) {
+			continue;
+		}
+		// Half a sensor period of slack, a sample arriving slightly early is still due
+		if(pWatcher->interval > current && now - pWatcher->lastDelivery + current / 2 < pWatcher->interval) {
+			continue;
+		}
+		pWatcher->lastDelivery = now;
+		pWatcher->pListener->OnDataReceived(sensorType, sensorData, r);
+	}
+	__dispatching = false;
+	Compact();
+}
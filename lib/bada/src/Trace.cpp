@@ -0,0 +1,143 @@
+/*
+ * Trace.cpp
+ *
+ *  Exposes the bridge latencies measured by the Tracer to the page, and writes
+ *  them to a file on demand.
+ */
+
+#include "../inc/Trace.h"
+#include "../inc/CommandRegistry.h"
+
+REGISTER_PHONEGAP_COMMAND(L"com.phonegap.Trace", Trace)
+
+static const mchar* TRACE_PATH = L"/Home/phonegap_trace.txt";
+static const mchar* STAGE_NAMES[TRACE_STAGE_COUNT] = { L"queue", L"handler", L"callback", L"total" };
+
+TraceDumpTask::TraceDumpTask(Trace& trace, const String& callbackId, const String& report)
+	: callbackId(callbackId), report(report), r(E_SUCCESS), __trace(trace) {
+}
+
+TraceDumpTask::~TraceDumpTask() {
+}
+
+void
+TraceDumpTask::Execute(void) {
+	File file;
+	r = file.Construct(TRACE_PATH, L"w", true);
+	if(IsFailed(r)) {
+		return;
+	}
+	r = file.Write(report);
+}
+
+void
+TraceDumpTask::Complete(void) {
+	__trace.OnDumpCompleted(*this);
+}
+
+Trace::Trace(Web* pWeb): PhoneGapCommand(pWeb) {
+	__pTracer = Tracer::GetInstance();
+}
+
+Trace::~Trace() {
+	Tracer::ReleaseInstance();
+}
+
+void
+Trace::Run(const CommandArgs& args) {
+	const String& method = args.GetMethod();
+	if(method == L"getStats" && args.HasCallback()) {
+		SendStats(args.GetCallbackId());
+	} else if(method == L"dump") {
+		Dump(args.GetCallbackId());
+	} else if(method == L"reset") {
+		__pTracer->Reset();
+	}
+}
+
+void
+Trace::SendStats(const String& callbackId) {
+	// [{name, queue: {count, p50, p95, p99, max}, handler: {...}, callback: {...}, total: {...}}, ...]
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	pScript->BeginCallback(callbackId, L"success").BeginArray();
+	IMapEnumeratorT<String, TraceStats*>* pStats = __pTracer->GetStatsN();
+	if(pStats) {
+		TraceStats* pEntry = null;
+		while(pStats->MoveNext() == E_SUCCESS) {
+			pStats->GetValue(pEntry);
+			pScript->BeginObject().Member(L"name").AppendString(pEntry->name);
+			for(int i = 0 ; i < TRACE_STAGE_COUNT ; i++) {
+				const LatencyHistogram& histogram = pEntry->stages[i];
+				pScript->Member(STAGE_NAMES[i]).BeginObject()
+						.Member(L"count").AppendInt(histogram.GetCount())
+						.Member(L"p50").AppendLong(histogram.GetPercentile(50))
+						.Member(L"p95").AppendLong(histogram.GetPercentile(95))
+						.Member(L"p99").AppendLong(histogram.GetPercentile(99))
+						.Member(L"max").AppendLong(histogram.GetMax())
+						.EndObject();
+			}
+			pScript->EndObject();
+		}
+		delete pStats;
+	}
+	pScript->EndArray().EndCallback();
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
+
+void
+Trace::Dump(const String& callbackId) {
+	// One line per service and per service.method, latencies in ms
+	String report(4096);
+	report.Append(L"name\tstage\tcount\tp50\tp95\tp99\tmax\n");
+	IMapEnumeratorT<String, TraceStats*>* pStats = __pTracer->GetStatsN();
+	if(pStats) {
+		TraceStats* pEntry = null;
+		while(pStats->MoveNext() == E_SUCCESS) {
+			pStats->GetValue(pEntry);
+			for(int i = 0 ; i < TRACE_STAGE_COUNT ; i++) {
+				const LatencyHistogram& histogram = pEntry->stages[i];
+				if(histogram.GetCount() == 0) {
+					continue;
+				}
+				report.Append(pEntry->name);
+				report.Append(L'\t');
+				report.Append(STAGE_NAMES[i]);
+				report.Append(L'\t');
+				report.Append(histogram.GetCount());
+				report.Append(L'\t');
+				report.Append(histogram.GetPercentile(50));
+				report.Append(L'\t');
+				report.Append(histogram.GetPercentile(95));
+				report.Append(L'\t');
+				report.Append(histogram.GetPercentile(99));
+				report.Append(L'\t');
+				report.Append(histogram.GetMax());
+				report.Append(L'\n');
+			}
+		}
+		delete pStats;
+	}
+
+	TraceDumpTask* pTask = new TraceDumpTask(*this, callbackId, report);
+	if(pWorker == null || IsFailed(pWorker->Post(pTask, lane))) {
+		pTask->Execute();
+		pTask->Complete();
+		delete pTask;
+	}
+}
+
+void
+Trace::OnDumpCompleted(TraceDumpTask& task) {
+	if(task.callbackId.IsEmpty()) {
+		return;
+	}
+	ScriptBuilder* pScript = ScriptBuilder::Acquire();
+	if(IsFailed(task.r)) {
+		pScript->BeginCallback(task.callbackId, L"fail").AppendString(String(GetErrorMessage(task.r))).EndCallback();
+	} else {
+		pScript->BeginCallback(task.callbackId, L"success").AppendString(TRACE_PATH).EndCallback();
+	}
+	pResults->Enqueue(pScript->GetString());
+	ScriptBuilder::Release(pScript);
+}
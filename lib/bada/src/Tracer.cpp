@@ -0,0 +1,315 @@
+/*
+ * Tracer.cpp
+ *
+ *  Timestamps every bridged command: when its gap:// URL was requested, when it was
+ *  dispatched, when its handler returned and when its first callback was evaluated.
+ *  Latencies are kept in histograms per service and per service.method.
+ */
+
+#include <FSystem.h>
+#include "../inc/Tracer.h"
+
+using namespace Osp::System;
+
+// Upper bound (ms) of each bucket, the last one holds everything slower
+static const long long BUCKET_BOUNDS[LatencyHistogram::BUCKET_COUNT - 1] = {
+	0, 1, 2, 3, 4, 5, 6, 8, 10, 12,
+	15, 20, 25, 30, 40, 50, 60, 80, 100, 125,
+	150, 200, 250, 300, 400, 500, 600, 800, 1000, 1250,
+	1500, 2000, 2500, 3000, 4000, 5000, 6000, 8000, 10000
+};
+
+static Tracer* __pInstance = null;
+static int __references = 0;
+
+LatencyHistogram::LatencyHistogram() {
+	Clear();
+}
+
+void
+LatencyHistogram::Clear(void) {
+	for(int i = 0 ; i < BUCKET_COUNT ; i++) {
+		__buckets[i] = 0;
+	}
+	__count = 0;
+	__max = 0;
+}
+
+void
+LatencyHistogram::Add(long long milliseconds) {
+	if(milliseconds < 0) {
+		milliseconds = 0;
+	}
+	int bucket = 0;
+	while(bucket < BUCKET_COUNT - 1 && milliseconds > BUCKET_BOUNDS[bucket]) {
+		bucket++;
+	}
+	__buckets[bucket]++;
+	__count++;
+	if(milliseconds > __max) {
+		__max = milliseconds;
+	}
+}
+
+int
+LatencyHistogram::GetCount(void) const {
+	return __count;
+}
+
+long long
+LatencyHistogram::GetMax(void) const {
+	return __max;
+}
+
+long long
+LatencyHistogram::GetPercentile(int percent) const {
+	if(__count == 0) {
+		return 0;
+	}
+	// Rank of the sample at that percentile, 1 based
+	int rank = (__count * percent + 99) / 100;
+	if(rank < 1) {
+		rank = 1;
+	}
+	int seen = 0;
+	for(int i = 0 ; i < BUCKET_COUNT - 1 ; i++) {
+		seen += __buckets[i];
+		if(seen >= rank) {
+			return BUCKET_BOUNDS[i] < __max ? BUCKET_BOUNDS[i] : __max;
+		}
+	}
+	return __max;
+}
+
+TraceStats::TraceStats(const String& name) : name(name) {
+}
+
+TraceStats::~TraceStats() {
+}
+
+TraceRecord::TraceRecord() : requestedAt(0), dispatchedAt(0), handledAt(0), answered(false) {
+}
+
+Tracer::Tracer() {
+}
+
+Tracer::~Tracer() {
+	ClearPending();
+	for(int i = 0 ; i < __running.GetCount() ; i++) {
+		TraceRecord* pRecord = null;
+		__running.GetAt(i, pRecord);
+		delete pRecord;
+	}
+	__running.RemoveAll();
+	for(int i = 0 ; i < __answered.GetCount() ; i++) {
+		TraceRecord* pRecord = null;
+		__answered.GetAt(i, pRecord);
+		delete pRecord;
+	}
+	__answered.RemoveAll();
+	IMapEnumeratorT<String, TraceStats*>* pStats = __stats.GetMapEnumeratorN();
+	if(pStats) {
+		TraceStats* pEntry = null;
+		while(pStats->MoveNext() == E_SUCCESS) {
+			pStats->GetValue(pEntry);
+			delete pEntry;
+		}
+		delete pStats;
+	}
+	__stats.RemoveAll();
+}
+
+result
+Tracer::Construct(void) {
+	result r = __lock.Create();
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __stats.Construct(32);
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __running.Construct(4);
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __pending.Construct(32);
+	if(IsFailed(r)) {
+		return r;
+	}
+	return __answered.Construct(8);
+}
+
+Tracer*
+Tracer::GetInstance(void) {
+	if(__pInstance == null) {
+		__pInstance = new Tracer();
+		if(IsFailed(__pInstance->Construct())) {
+			AppLogException("Could not construct tracer");
+		}
+	}
+	__references++;
+	return __pInstance;
+}
+
+void
+Tracer::ReleaseInstance(void) {
+	if(__references > 0 && --__references == 0) {
+		delete __pInstance;
+		__pInstance = null;
+	}
+}
+
+Tracer*
+Tracer::GetCurrent(void) {
+	return __pInstance;
+}
+
+long long
+Tracer::GetTicks(void) {
+	long long ticks = 0;
+	SystemTime::GetTicks(ticks);
+	return ticks;
+}
+
+TraceRecord*
+Tracer::Begin(const String& service, const String& method, const String& callbackId, long long requestedAt) {
+	TraceRecord* pRecord = new TraceRecord();
+	pRecord->service = service;
+	pRecord->method = method;
+	pRecord->callbackId = callbackId;
+	pRecord->dispatchedAt = GetTicks();
+	pRecord->requestedAt = requestedAt > 0 ? requestedAt : pRecord->dispatchedAt;
+	__lock.Acquire();
+	__running.Add(pRecord);
+	__lock.Release();
+	return pRecord;
+}
+
+void
+Tracer::Handled(TraceRecord* pRecord) {
+	long long now = GetTicks();
+	__lock.Acquire();
+	pRecord->handledAt = now;
+	__lock.Release();
+}
+
+void
+Tracer::End(TraceRecord* pRecord) {
+	__lock.Acquire();
+	__running.Remove(pRecord);
+	if(pRecord->handledAt == 0) {
+		pRecord->handledAt = GetTicks();
+	}
+	Add(*pRecord, TRACE_STAGE_QUEUE, pRecord->dispatchedAt - pRecord->requestedAt);
+	Add(*pRecord, TRACE_STAGE_HANDLER, pRecord->handledAt - pRecord->dispatchedAt);
+	if(pRecord->callbackId.IsEmpty()) {
+		delete pRecord;
+	} else if(pRecord->answered) {
+		// Answered from within the handler
+		__answered.Add(pRecord);
+	} else {
+		TraceRecord* pPrevious = null;
+		if(__pending.GetValue(pRecord->callbackId, pPrevious) == E_SUCCESS) {
+			__pending.Remove(pRecord->callbackId);
+			delete pPrevious;
+		}
+		if(__pending.GetCount() >= MAX_PENDING) {
+			AppLogDebug("%d commands never answered, dropping them", __pending.GetCount());
+			ClearPending();
+		}
+		__pending.Add(pRecord->callbackId, pRecord);
+	}
+	__lock.Release();
+}
+
+void
+Tracer::Answered(const String& callbackId) {
+	__lock.Acquire();
+	for(int i = 0 ; i < __running.GetCount() ; i++) {
+		TraceRecord* pRecord = null;
+		__running.GetAt(i, pRecord);
+		if(pRecord->callbackId == callbackId) {
+			pRecord->answered = true;
+			__lock.Release();
+			return;
+		}
+	}
+	// Only the first callback is timed, later ones (watches) find nothing pending
+	TraceRecord* pRecord = null;
+	if(__pending.GetValue(callbackId, pRecord) == E_SUCCESS && pRecord) {
+		__pending.Remove(callbackId);
+		__answered.Add(pRecord);
+	}
+	__lock.Release();
+}
+
+void
+Tracer::Delivered(void) {
+	long long now = GetTicks();
+	__lock.Acquire();
+	for(int i = 0 ; i < __answered.GetCount() ; i++) {
+		TraceRecord* pRecord = null;
+		__answered.GetAt(i, pRecord);
+		Add(*pRecord, TRACE_STAGE_CALLBACK, now - pRecord->handledAt);
+		Add(*pRecord, TRACE_STAGE_TOTAL, now - pRecord->requestedAt);
+		delete pRecord;
+	}
+	__answered.RemoveAll();
+	__lock.Release();
+}
+
+void
+Tracer::Add(const TraceRecord& record, TraceStage stage, long long milliseconds) {
+	GetStats(record.service)->stages[stage].Add(milliseconds);
+	String name(record.service);
+	name.Append(L'.');
+	name.Append(record.method);
+	GetStats(name)->stages[stage].Add(milliseconds);
+}
+
+TraceStats*
+Tracer::GetStats(const String& name) {
+	TraceStats* pStats = null;
+	if(__stats.GetValue(name, pStats) != E_SUCCESS || pStats == null) {
+		pStats = new TraceStats(name);
+		__stats.Add(name, pStats);
+	}
+	return pStats;
+}
+
+void
+Tracer::ClearPending(void) {
+	IMapEnumeratorT<String, TraceRecord*>* pPending = __pending.GetMapEnumeratorN();
+	if(pPending) {
+		TraceRecord* pRecord = null;
+		while(pPending->MoveNext() == E_SUCCESS) {
+			pPending->GetValue(pRecord);
+			delete pRecord;
+		}
+		delete pPending;
+	}
+	__pending.RemoveAll();
+}
+
+void
+Tracer::Reset(void) {
+	__lock.Acquire();
+	IMapEnumeratorT<String, TraceStats*>* pStats = __stats.GetMapEnumeratorN();
+	if(pStats) {
+		TraceStats* pEntry = null;
+		while(pStats->MoveNext() == E_SUCCESS) {
+			pStats->GetValue(pEntry);
+			for(int i = 0 ; i < TRACE_STAGE_COUNT ; i++) {
+				pEntry->stages[i].Clear();
+			}
+		}
+		delete pStats;
+	}
+	__lock.Release();
+}
+
+IMapEnumeratorT<String, TraceStats*>*
+Tracer::GetStatsN(void) const {
+	return __stats.GetMapEnumeratorN();
+}
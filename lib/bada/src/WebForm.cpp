@@ -1,18 +1,61 @@
 #include "WebForm.h"
+#include "Qos.h"
+
+CommandTask::CommandTask(PhoneGapCommand& command, const CommandArgs& args, TraceRecord* pRecord)
+	: __command(command), __args(args), __pRecord(pRecord) {
+}
+
+CommandTask::~CommandTask() {
+}
+
+void
+CommandTask::Execute(void) {
+	__command.Run(__args);
+	Tracer* pTracer = Tracer::GetCurrent();
+	if(pTracer && __pRecord) {
+		pTracer->Handled(__pRecord);
+	}
+}
+
+void
+CommandTask::Complete(void) {
+	Tracer* pTracer = Tracer::GetCurrent();
+	if(pTracer && __pRecord) {
+		pTracer->End(__pRecord);
+	}
+}
 
 WebForm::WebForm(void)
-	:__pWeb(null), __phonegapCommand(null)
+	:__pWeb(null), __pRegistry(null), __pResults(null), __pWorker(null), __pCommands(null), __pageState(PAGE_LOADING), __suspended(false), __pTracer(null), __pQos(null), __requestedAt(0)
 {
-	geolocation = null;
-	device = null;
-	accel = null;
-	network = null;
-	console = null;
-	compass = null;
-	contacts = null;
 }
 
 WebForm::~WebForm(void) {
+	if(__pCommands) {
+		__pCommands->RemoveAll(true);
+		delete __pCommands;
+	}
+	// Running tasks finish before the handlers they report to are deleted, and those whose
+	// completion is still queued to this form are completed here
+	if(__pWorker) {
+		__pWorker->Stop();
+		__pWorker->Join();
+		__pWorker->Drain();
+	}
+	// Handlers flushing from their destructor (e.g. the console) do it inline
+	if(__pRegistry) {
+		__pRegistry->DetachWorker();
+	}
+	delete __pWorker;
+	delete __pRegistry;
+	delete __pResults;
+	if(__pTracer) {
+		Tracer::ReleaseInstance();
+	}
+	if(__pQos) {
+		__pQos->SetListener(null);
+		QosPolicy::ReleaseInstance();
+	}
 }
 
 bool
@@ -21,6 +64,74 @@ WebForm::Initialize()
 	return true;
 }
 
+void
+WebForm::Suspend(void) {
+	if(__suspended || __pRegistry == null) {
+		return;
+	}
+	__suspended = true;
+	__pRegistry->Suspend();
+	__pResults->SetPaused(true);
+	AppLogDebug("Page suspended");
+}
+
+void
+WebForm::Resume(void) {
+	if(!__suspended || __pRegistry == null) {
+		return;
+	}
+	__suspended = false;
+	__pRegistry->Resume();
+	// What was answered while hidden is delivered in one evaluation
+	__pResults->SetPaused(false);
+	AppLogDebug("Page resumed");
+}
+
+bool
+WebForm::IsSuspended(void) const {
+	return __suspended;
+}
+
+void
+WebForm::OnQosChanged(const QosPolicy& policy) {
+	if(__pRegistry == null) {
+		return;
+	}
+	__pResults->SetFlushInterval(policy.GetFlushInterval());
+	__pRegistry->ApplyQos();
+	if(__pageState == PAGE_READY) {
+		ScriptBuilder* pScript = ScriptBuilder::Acquire();
+		pScript->AppendRaw(L"if(navigator.qos)").BeginCall(L"navigator.qos._update");
+		Qos::AppendPolicy(*pScript, policy);
+		pScript->EndCall().AppendRaw(L";");
+		__pResults->Enqueue(pScript->GetString());
+		ScriptBuilder::Release(pScript);
+	}
+}
+
+long
+WebForm::ReleaseMemory(void) {
+	if(__pRegistry == null) {
+		return 0;
+	}
+	long freed = __pRegistry->ReleaseMemory();
+	freed += __pResults->Compact();
+	freed += ScriptBuilder::ShrinkPool();
+	__pWeb->ClearCache();
+	if(__pageState == PAGE_READY) {
+		// Evaluated right away, even while suspended: the page may hold much more than we do
+		ScriptBuilder* pScript = ScriptBuilder::Acquire();
+		pScript->BeginCall(L"PhoneGap.onLowMemory.fire").BeginObject()
+				.Member(L"freed").AppendLong(freed)
+				.EndObject().EndCall().AppendRaw(L";");
+		String* pResult = __pWeb->EvaluateJavascriptN(pScript->GetString());
+		delete pResult;
+		ScriptBuilder::Release(pScript);
+	}
+	AppLogDebug("Low memory, %ld bytes freed", freed);
+	return freed;
+}
+
 result
 WebForm::OnInitializing(void)
 {
@@ -35,6 +146,7 @@ WebForm::OnInitializing(void)
 		goto CATCH;
 	}
 
+	__pageState = PAGE_LOADING;
 	__pWeb->LoadUrl("file:///Res/index.html");
 	//__pWeb->LoadUrl("file:///Res/mobile-spec/index.html");
 
@@ -48,17 +160,6 @@ result
 WebForm::OnTerminating(void)
 {
 	result r = E_SUCCESS;
-
-//	delete __phonegapCommand;
-//	delete geolocation;
-//	delete device;
-//	delete accel;
-//	delete network;
-//	delete console;
-//	delete compass;
-//	delete contacts;
-//	delete notification;
-//	delete camera;
 	return r;
 }
 
@@ -72,6 +173,27 @@ WebForm::OnActionPerformed(const Osp::Ui::Control& source, int actionId)
 	}
 }
 
+void
+WebForm::OnUserEventReceivedN(RequestId requestId, Osp::Base::Collection::IList* pArgs)
+{
+	if(requestId == Worker::REQUEST_COMPLETE) {
+		if(__pWorker) {
+			__pWorker->Complete(pArgs);
+		} else {
+			delete pArgs;
+		}
+		return;
+	}
+	if(requestId == ResultQueue::REQUEST_FLUSH) {
+		// Results enqueued by a worker
+		__pResults->Flush();
+	}
+	if(pArgs) {
+		pArgs->RemoveAll(true);
+		delete pArgs;
+	}
+}
+
 void
 WebForm::LaunchBrowser(const String& url) {
 	ArrayList* pDataList = null;
@@ -97,9 +219,7 @@ bool
 WebForm::OnLoadingRequested (const Osp::Base::String& url, WebNavigationType type) {
 	AppLogDebug("URL REQUESTED %S", url.GetPointer());
 	if(url.StartsWith("gap://", 0)) {
-//		__phonegapCommand = null;
-
-		__phonegapCommand = new String(url);
+		QueueCommands(url);
 		//	FIXME: for some reason this does not work if we return true. Web freezes.
 //		__pWeb->StopLoading();
 //		String* test;
@@ -114,52 +234,125 @@ WebForm::OnLoadingRequested (const Osp::Base::String& url, WebNavigationType typ
 		return false;
 	}
 
+	// A new document replaces the page, it has to be announced again once loaded. Blank
+	// frames and moves within the current document keep it.
+	if(!url.StartsWith(L"about:", 0) && !IsSameDocument(url)) {
+		__pageState = PAGE_LOADING;
+	}
 	return false;
 }
 
+bool
+WebForm::IsSameDocument(const String& url) const {
+	String current = __pWeb->GetUrl();
+	int fragment = 0;
+	if(url.IndexOf(L'#', 0, fragment) != E_SUCCESS) {
+		return false;
+	}
+	int currentFragment = 0;
+	if(current.IndexOf(L'#', 0, currentFragment) != E_SUCCESS) {
+		currentFragment = current.GetLength();
+	}
+	String document;
+	url.SubString(0, fragment, document);
+	String currentDocument;
+	current.SubString(0, currentFragment, currentDocument);
+	return document == currentDocument;
+}
+
 void
-WebForm::OnLoadingCompleted() {
-	// Setting DeviceInfo to initialize PhoneGap (should be done only once) and firing onNativeReady event
-	String* deviceInfo;
-	deviceInfo = __pWeb->EvaluateJavascriptN(L"window.device.uuid");
-	if(deviceInfo->IsEmpty()) {
-		device->SetDeviceInfo();
-		__pWeb->EvaluateJavascriptN("PhoneGap.onNativeReady.fire();");
-	} else {
-		//AppLogDebug("DeviceInfo = %S;", deviceInfo->GetPointer());
-	}
-	delete deviceInfo;
-
-	// Analyzing PhoneGap command
-	if(__phonegapCommand) {
-		if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Geolocation", 0)) {
-			geolocation->Run(*__phonegapCommand);
-		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Accelerometer", 0)) {
-			accel->Run(*__phonegapCommand);
-		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Network", 0)) {
-			network->Run(*__phonegapCommand);
-		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.DebugConsole", 0)) {
-			console->Run(*__phonegapCommand);
-		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Compass", 0)) {
-			compass->Run(*__phonegapCommand);
-		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Contacts", 0)) {
-			contacts->Run(*__phonegapCommand);
+WebForm::QueueCommands(const String& url) {
+	if(__pCommands->GetCount() == 0) {
+		__requestedAt = Tracer::GetTicks();
+	}
+	String batchPrefix(L"gap://batch/");
+	if(!url.StartsWith(batchPrefix, 0)) {
+		__pCommands->Add(*(new String(url)));
+		return;
+	}
+
+	// Batched commands: gap://batch/<encoded command>/<encoded command>/...
+	String commands;
+	url.SubString(batchPrefix.GetLength(), commands);
+	StringTokenizer strTok(commands, L"/");
+	String encoded;
+	while(strTok.HasMoreTokens()) {
+		strTok.GetNextToken(encoded);
+		String decoded;
+		result r = UrlDecoder::Decode(encoded, L"UTF-8", decoded);
+		if(IsFailed(r)) {
+			AppLogException("Could not decode batched command %S", encoded.GetPointer());
+			continue;
 		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Notification", 0)) {
-			notification->Run(*__phonegapCommand);
+		String* pCommand = new String(L"gap://");
+		pCommand->Append(decoded);
+		__pCommands->Add(*pCommand);
+	}
+	AppLogDebug("Batch of %d commands queued", __pCommands->GetCount());
+}
+
+void
+WebForm::DispatchCommand(const String& command) {
+	// Parsed once, the handler gets a typed view of the arguments
+	if(IsFailed(__args.Parse(command))) {
+		return;
+	}
+	PhoneGapCommand* pCommand = __pRegistry->GetCommand(__args.GetService());
+	if(pCommand) {
+		TraceRecord* pRecord = __pTracer->Begin(__args.GetService(), __args.GetMethod(), __args.GetCallbackId(), __requestedAt);
+		if(pCommand->GetMode() == COMMAND_MODE_WORKER) {
+			// Results come back through the result queue, the batch goes on meanwhile
+			CommandTask* pTask = new CommandTask(*pCommand, __args, pRecord);
+			if(__pWorker && !IsFailed(__pWorker->Post(pTask, pCommand->GetLane()))) {
+				return;
+			}
+			delete pTask;
 		}
-		else if(__phonegapCommand->StartsWith(L"gap://com.phonegap.Camera", 0)) {
-			camera->Run(*__phonegapCommand);
+		pCommand->Run(__args);
+		__pTracer->End(pRecord);
+	}
+	else {
+		AppLogDebug("Unknown command %S", command.GetPointer());
+	}
+}
+
+void
+WebForm::AnnounceNative(void) {
+	// window.device and onNativeReady in one evaluation, the device record is only read once.
+	// Guarded: a load we took for a new document may have been a frame of the current one
+	String script(512);
+	script.Append(L"if(window.PhoneGap&&!PhoneGap.onNativeReady.fired){");
+	Device* pDevice = static_cast<Device*>(__pRegistry->GetCommand(L"com.phonegap.Device"));
+	if(pDevice) {
+		script.Append(pDevice->GetDeviceScript());
+	}
+	script.Append(L"PhoneGap.onNativeReady.fire();}");
+	String* pResult = __pWeb->EvaluateJavascriptN(script);
+	delete pResult;
+	__pageState = PAGE_READY;
+	AppLogDebug("Native side announced");
+}
+
+void
+WebForm::OnLoadingCompleted() {
+	// Command round trips complete too, only a new document needs PhoneGap to be initialized
+	if(__pageState == PAGE_LOADING) {
+		AnnounceNative();
+	}
+
+	// Analyzing PhoneGap commands, the whole batch is dispatched in one pass
+	if(__pCommands->GetCount() > 0) {
+		IEnumerator* pEnum = __pCommands->GetEnumeratorN();
+		while(pEnum->MoveNext() == E_SUCCESS) {
+			DispatchCommand(*static_cast<String*>(pEnum->GetCurrent()));
 		}
-		// Tell the JS code that we got this command, and we're ready for another
-		__pWeb->EvaluateJavascriptN(L"PhoneGap.queue.ready = true;");
-		delete __phonegapCommand;
-		__phonegapCommand = null;
+		delete pEnum;
+		__pCommands->RemoveAll(true);
+
+		// Tell the JS code that we got this batch, and we're ready for another.
+		// Delivered together with the results of the batch in one evaluation
+		__pResults->Enqueue(L"PhoneGap.queue.ack();");
+		__pResults->Flush();
 	}
 	else {
 		AppLogDebug("Non PhoneGap command completed");
@@ -192,17 +385,36 @@ WebForm::CreateWebControl(void)
 
 	__pWeb->SetFocus();
 
-	if(__pWeb) {
-		geolocation = new GeoLocation(__pWeb);
-		device = new Device(__pWeb);
-		accel = new Accelerometer(__pWeb);
-		network = new Network(__pWeb);
-		console = new DebugConsole(__pWeb);
-		compass = new Compass(__pWeb);
-		contacts = new Contacts(__pWeb);
-		notification = new Notification(__pWeb);
-		camera = new Kamera(__pWeb);
-	}
+	__pCommands = new ArrayList();
+	__pCommands->Construct();
+
+	// Bridge latencies, read by the com.phonegap.Trace command
+	__pTracer = Tracer::GetInstance();
+
+	__pResults = new ResultQueue();
+	r = __pResults->Construct(__pWeb, *this);
+	TryCatch(r == E_SUCCESS, ,"Result queue is not constructed\n ");
+
+	// Handlers running on the workers build their results concurrently
+	r = ScriptBuilder::InitializePool();
+	TryCatch(r == E_SUCCESS, ,"Script builder pool is not initialized\n ");
+
+	__pWorker = new Worker();
+	r = __pWorker->Construct(*this);
+	TryCatch(r == E_SUCCESS, ,"Worker is not constructed\n ");
+	r = __pWorker->Start();
+	TryCatch(r == E_SUCCESS, ,"Worker is not started\n ");
+
+	// Command handlers are created on their first command
+	__pRegistry = new CommandRegistry(__pWeb, __pResults, __pWorker);
+	r = __pRegistry->Construct();
+	TryCatch(r == E_SUCCESS, ,"Command registry is not constructed\n ");
+
+	// Tier from the battery level, handlers read it when they start producing
+	__pQos = QosPolicy::GetInstance();
+	__pQos->SetListener(this);
+	__pResults->SetFlushInterval(__pQos->GetFlushInterval());
+
 	return r;
 
 CATCH:
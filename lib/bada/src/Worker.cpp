@@ -0,0 +1,198 @@
+/*
+ * Worker.cpp
+ *
+ *  Runs slow work (decoding, encoding, file copies, address book queries) off the UI
+ *  thread. A WorkerTask is executed on a worker thread and completed back on the UI
+ *  thread, where it may use the Web control.
+ */
+
+#include "../inc/Worker.h"
+
+WorkerTask::WorkerTask() : __executed(false) {
+}
+
+WorkerTask::~WorkerTask() {
+}
+
+bool
+WorkerTask::IsExecuted(void) const {
+	return __executed;
+}
+
+WorkerThread::WorkerThread() : __pOwner(null) {
+}
+
+WorkerThread::~WorkerThread() {
+}
+
+result
+WorkerThread::Construct(Control& owner) {
+	__pOwner = &owner;
+	return Thread::Construct(THREAD_TYPE_EVENT_DRIVEN);
+}
+
+result
+WorkerThread::Post(WorkerTask* pTask) {
+	ArrayList* pArgs = new ArrayList();
+	pArgs->Construct(1);
+	pArgs->Add(*pTask);
+	result r = SendUserEvent(Worker::REQUEST_EXECUTE, pArgs);
+	if(IsFailed(r)) {
+		AppLogException("Could not post task to the worker");
+		// The caller keeps the task
+		pArgs->RemoveAll(false);
+		delete pArgs;
+	}
+	return r;
+}
+
+void
+WorkerThread::OnUserEventReceivedN(RequestId requestId, IList* pArgs) {
+	if(requestId != Worker::REQUEST_EXECUTE || pArgs == null) {
+		delete pArgs;
+		return;
+	}
+	WorkerTask* pTask = static_cast<WorkerTask*>(pArgs->GetAt(0));
+	if(pTask) {
+		pTask->Execute();
+		pTask->__executed = true;
+	}
+	// The same list carries the task back to the UI thread
+	if(IsFailed(__pOwner->SendUserEvent(Worker::REQUEST_COMPLETE, pArgs))) {
+		// The worker still holds the task, Drain() completes it
+		AppLogException("Could not complete task");
+		pArgs->RemoveAll(false);
+		delete pArgs;
+	}
+}
+
+Worker::Worker() : __threadCount(0) {
+	for(int i = 0 ; i < MAX_THREAD_COUNT ; i++) {
+		__threads[i] = null;
+	}
+}
+
+Worker::~Worker() {
+	for(int i = 0 ; i < __threadCount ; i++) {
+		delete __threads[i];
+	}
+	// Never drained, the tasks are not completed but do not leak
+	for(int i = 0 ; i < __tasks.GetCount() ; i++) {
+		WorkerTask* pTask = null;
+		__tasks.GetAt(i, pTask);
+		delete pTask;
+	}
+}
+
+result
+Worker::Construct(Control& owner, int threadCount) {
+	if(threadCount < 1) {
+		threadCount = 1;
+	} else if(threadCount > MAX_THREAD_COUNT) {
+		threadCount = MAX_THREAD_COUNT;
+	}
+	result r = __tasks.Construct();
+	if(IsFailed(r)) {
+		return r;
+	}
+	r = __lock.Create();
+	if(IsFailed(r)) {
+		return r;
+	}
+	for(int i = 0 ; i < threadCount ; i++) {
+		WorkerThread* pThread = new WorkerThread();
+		r = pThread->Construct(owner);
+		if(IsFailed(r)) {
+			delete pThread;
+			// Fewer threads are fine as long as there is one
+			return __threadCount > 0 ? E_SUCCESS : r;
+		}
+		__threads[__threadCount++] = pThread;
+	}
+	return E_SUCCESS;
+}
+
+result
+Worker::Start(void) {
+	for(int i = 0 ; i < __threadCount ; i++) {
+		result r = __threads[i]->Start();
+		if(IsFailed(r)) {
+			return r;
+		}
+	}
+	return E_SUCCESS;
+}
+
+void
+Worker::Stop(void) {
+	for(int i = 0 ; i < __threadCount ; i++) {
+		__threads[i]->Stop();
+	}
+}
+
+void
+Worker::Join(void) {
+	for(int i = 0 ; i < __threadCount ; i++) {
+		__threads[i]->Join();
+	}
+}
+
+int
+Worker::GetLaneCount(void) const {
+	return __threadCount;
+}
+
+result
+Worker::Post(WorkerTask* pTask, int lane) {
+	if(__threadCount == 0) {
+		return E_INVALID_STATE;
+	}
+	if(lane < 0) {
+		lane = -lane;
+	}
+	__lock.Acquire();
+	__tasks.Add(pTask);
+	__lock.Release();
+	result r = __threads[lane % __threadCount]->Post(pTask);
+	if(IsFailed(r)) {
+		Remove(pTask);
+	}
+	return r;
+}
+
+bool
+Worker::Remove(WorkerTask* pTask) {
+	__lock.Acquire();
+	bool held = __tasks.Remove(pTask) == E_SUCCESS;
+	__lock.Release();
+	return held;
+}
+
+void
+Worker::Complete(IList* pArgs) {
+	if(pArgs == null) {
+		return;
+	}
+	WorkerTask* pTask = static_cast<WorkerTask*>(pArgs->GetAt(0));
+	pArgs->RemoveAll(false);
+	delete pArgs;
+	// Already settled by Drain() otherwise
+	if(pTask && Remove(pTask)) {
+		pTask->Complete();
+		delete pTask;
+	}
+}
+
+void
+Worker::Drain(void) {
+	// Completions may post again, those tasks are never run and only deleted
+	while(__tasks.GetCount() > 0) {
+		WorkerTask* pTask = null;
+		__tasks.GetAt(0, pTask);
+		__tasks.RemoveAt(0);
+		if(pTask->IsExecuted()) {
+			pTask->Complete();
+		}
+		delete pTask;
+	}
+}